@@ -0,0 +1,209 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#define _GNU_SOURCE
+
+#include "features.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
+
+const char *feature_names[N_FEATURES] = {
+    "n_min", "n_max", "density_min", "density_max", "degree_cv",
+    "label_classes", "root_bound", "root_ratio", "connected"
+};
+
+static void fail(const char* msg) {
+    printf("%s\n", msg);
+    exit(1);
+}
+
+static double density(sparse_graph_t *g) {
+    if (g->n < 2) return 0;
+    return (double)sparse_edge_count(g) / ((double)g->n * (g->n - 1));
+}
+
+static double degree_cv(sparse_graph_t *g) {
+    if (g->n == 0) return 0;
+    double mean = 0, var = 0;
+    for (int v = 0; v < g->n; v++) mean += g->offset[v + 1] - g->offset[v];
+    mean /= g->n;
+    if (mean == 0) return 0;
+    for (int v = 0; v < g->n; v++) {
+        double d = g->offset[v + 1] - g->offset[v] - mean;
+        var += d * d;
+    }
+    return sqrt(var / g->n) / mean;
+}
+
+static int cmp_uint(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned int *sorted_labels(sparse_graph_t *g) {
+    unsigned int *labels = malloc((g->n + 1) * sizeof *labels);
+    memcpy(labels, g->label, g->n * sizeof *labels);
+    qsort(labels, g->n, sizeof *labels, cmp_uint);
+    return labels;
+}
+
+void compute_features(sparse_graph_t *g0, sparse_graph_t *g1, bool connected, double *features) {
+    features[F_N_MIN] = MIN(g0->n, g1->n);
+    features[F_N_MAX] = MAX(g0->n, g1->n);
+    features[F_DENSITY_MIN] = MIN(density(g0), density(g1));
+    features[F_DENSITY_MAX] = MAX(density(g0), density(g1));
+    features[F_DEGREE_CV] = MAX(degree_cv(g0), degree_cv(g1));
+
+    // the root bidomains are the label classes: merge the two sorted label lists
+    unsigned int *l0 = sorted_labels(g0), *l1 = sorted_labels(g1);
+    int classes = 0, bound = 0;
+    for (int i = 0, j = 0; i < g0->n && j < g1->n; ) {
+        if (l0[i] < l1[j]) { i++; continue; }
+        if (l0[i] > l1[j]) { j++; continue; }
+        unsigned int label = l0[i];
+        int c0 = 0, c1 = 0;
+        while (i < g0->n && l0[i] == label) { i++; c0++; }
+        while (j < g1->n && l1[j] == label) { j++; c1++; }
+        classes++;
+        bound += MIN(c0, c1);
+    }
+    free(l0);
+    free(l1);
+    features[F_LABEL_CLASSES] = classes;
+    features[F_ROOT_BOUND] = bound;
+    features[F_ROOT_RATIO] = features[F_N_MIN] > 0 ? bound / features[F_N_MIN] : 0;
+    features[F_CONNECTED] = connected;
+}
+
+int feature_index(const char *name) {
+    for (int i = 0; i < N_FEATURES; i++)
+        if (strcmp(name, feature_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+static void add_rule(rule_list_t *rules, char *line, int line_num) {
+    char msg[256];
+    char *colon = strchr(line, ':');
+    if (colon == NULL) {
+        snprintf(msg, sizeof msg, "Rule %d: missing ':' before the engine", line_num);
+        fail(msg);
+    }
+    *colon = '\0';
+    if (rules->len == rules->size) {
+        rules->size = 2 * rules->size + 1;
+        rules->vals = realloc(rules->vals, rules->size * sizeof *rules->vals);
+    }
+    rule_t *rule = &rules->vals[rules->len++];
+    memset(rule, 0, sizeof *rule);
+
+    char *save, *tok = strtok_r(line, " \t", &save);
+    while (tok != NULL) {
+        char *op = strtok_r(NULL, " \t", &save);
+        char *value = strtok_r(NULL, " \t", &save);
+        int f = feature_index(tok);
+        if (f == -1 || op == NULL || value == NULL || rule->n_conditions == MAX_CONDITIONS ||
+                (strcmp(op, "<") && strcmp(op, "<=") && strcmp(op, ">") && strcmp(op, ">=") && strcmp(op, "="))) {
+            snprintf(msg, sizeof msg, "Rule %d: bad condition '%s'", line_num, tok);
+            fail(msg);
+        }
+        rule->feature[rule->n_conditions] = f;
+        strcpy(rule->op[rule->n_conditions], op);
+        rule->value[rule->n_conditions] = strtod(value, NULL);
+        rule->n_conditions++;
+        tok = strtok_r(NULL, " \t", &save);
+    }
+
+    for (tok = strtok_r(colon + 1, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save)) {
+        if (rule->engine == NULL) {
+            rule->engine = strdup(tok);
+        } else if (rule->n_args < MAX_ENGINE_ARGS) {
+            rule->args[rule->n_args++] = strdup(tok);
+        } else {
+            snprintf(msg, sizeof msg, "Rule %d: too many engine options", line_num);
+            fail(msg);
+        }
+    }
+    if (rule->engine == NULL) {
+        snprintf(msg, sizeof msg, "Rule %d: missing engine", line_num);
+        fail(msg);
+    }
+}
+
+rule_list_t *parse_rules(const char *text) {
+    rule_list_t *rules = calloc(1, sizeof *rules);
+    char *copy = strdup(text);
+    int line_num = 0;
+    // strtok_r would merge empty lines and shift the numbering, so split by hand
+    for (char *line = copy, *next; line != NULL; line = next) {
+        next = strchr(line, '\n');
+        if (next != NULL) *next++ = '\0';
+        line_num++;
+        line[strcspn(line, "#\r")] = '\0';
+        if (line[strspn(line, " \t")] == '\0') continue;   // blank line
+        add_rule(rules, line, line_num);
+    }
+    free(copy);
+    return rules;
+}
+
+rule_list_t *read_rules(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+        fail("Cannot open the rules file");
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(len + 1);
+    if (fread(text, 1, len, f) != len)
+        fail("Error reading the rules file");
+    text[len] = '\0';
+    fclose(f);
+    rule_list_t *rules = parse_rules(text);
+    free(text);
+    return rules;
+}
+
+bool rule_matches(rule_t *rule, double *features) {
+    for (unsigned int i = 0; i < rule->n_conditions; i++) {
+        double x = features[rule->feature[i]], value = rule->value[i];
+        const char *op = rule->op[i];
+        bool holds = strcmp(op, "<") == 0 ? x < value :
+                     strcmp(op, "<=") == 0 ? x <= value :
+                     strcmp(op, ">") == 0 ? x > value :
+                     strcmp(op, ">=") == 0 ? x >= value : x == value;
+        if (!holds) return false;
+    }
+    return true;
+}
+
+void free_rules(rule_list_t *rules) {
+    for (unsigned int r = 0; r < rules->len; r++) {
+        free(rules->vals[r].engine);
+        for (unsigned int a = 0; a < rules->vals[r].n_args; a++)
+            free(rules->vals[r].args[a]);
+    }
+    free(rules->vals);
+    free(rules);
+}
@@ -0,0 +1,77 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef FEATURES_H_
+#define FEATURES_H_
+
+#include "graph.h"
+
+#include <stdbool.h>
+
+// Cheap instance features, computed once from the two graphs as adjacency
+// lists, so that no n*n matrix is built. They are kept as an array of named
+// values so that rules can refer to any of them.
+enum {
+    F_N_MIN, F_N_MAX,               // vertices of the smaller and larger graph
+    F_DENSITY_MIN, F_DENSITY_MAX,   // edge densities
+    F_DEGREE_CV,                    // largest coefficient of variation of the degrees
+    F_LABEL_CLASSES,                // vertex labels present in both graphs
+    F_ROOT_BOUND,                   // calc_bound of the root bidomains
+    F_ROOT_RATIO,                   // root bound over n_min
+    F_CONNECTED,                    // 1 when a connected mapping is asked for
+    N_FEATURES
+};
+
+extern const char *feature_names[N_FEATURES];
+
+void compute_features(sparse_graph_t *g0, sparse_graph_t *g1, bool connected, double *features);
+
+int feature_index(const char *name);
+
+// A rule is a conjunction of conditions FEATURE OP VALUE followed by the
+// engine to run and its options. Rules form a decision list: the first one
+// whose conditions all hold is chosen.
+#define MAX_CONDITIONS 8
+#define MAX_ENGINE_ARGS 16
+
+typedef struct rule_s {
+    unsigned int n_conditions;
+    int feature[MAX_CONDITIONS];
+    char op[MAX_CONDITIONS][3];
+    double value[MAX_CONDITIONS];
+    char *engine;
+    unsigned int n_args;
+    char *args[MAX_ENGINE_ARGS];
+}rule_t;
+
+typedef struct rule_list_s {
+    rule_t *vals;
+    unsigned len;
+    unsigned size;
+}rule_list_t;
+
+// Parses one rule per line, "#" starts a comment. Exits on malformed rules.
+rule_list_t *parse_rules(const char *text);
+
+rule_list_t *read_rules(const char *filename);
+
+bool rule_matches(rule_t *rule, double *features);
+
+void free_rules(rule_list_t *rules);
+
+#endif /* FEATURES_H_ */
@@ -0,0 +1,375 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+// fit_rules: turns the features printed by auto_select --features and the
+// times of the engines on the same pairs into a decision list for --rules.
+
+#define _GNU_SOURCE
+
+#include <argp.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "features.h"
+
+#define MAX_FIELDS (N_FEATURES + 2)
+
+static char doc[] = "Fit auto_select rules to the engine times of a set of pairs of graphs\v"
+        "FEATURES holds the CSV lines of auto_select --features, header lines included. "
+        "TIMES holds one run per line: FILENAME1 FILENAME2 SECONDS ENGINE [OPTIONS...], "
+        "with the timeout as SECONDS for runs that timed out. "
+        "The rules are printed on stdout.";
+static char args_doc[] = "FEATURES TIMES";
+static struct argp_option options[] = {
+        {"max-rules", 'n', "N", 0, "At most N rules before the default one (default 8)"},
+        {"min-pairs", 'm', "K", 0, "Each rule covers at least K pairs (default 3)"},
+        { 0 }
+};
+
+static struct {
+    int max_rules;
+    int min_pairs;
+    char *features;
+    char *times;
+    int arg_num;
+} arguments;
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+    switch (key) {
+        case 'n':
+            arguments.max_rules = strtol(arg, NULL, 10);
+            break;
+        case 'm':
+            arguments.min_pairs = strtol(arg, NULL, 10);
+            if (arguments.min_pairs < 1)
+                argp_error(state, "--min-pairs must be at least 1");
+            break;
+        case ARGP_KEY_ARG:
+            if (arguments.arg_num == 0) {
+                arguments.features = arg;
+            } else if (arguments.arg_num == 1) {
+                arguments.times = arg;
+            } else {
+                argp_usage(state);
+            }
+            arguments.arg_num++;
+            break;
+        case ARGP_KEY_END:
+            if (arguments.arg_num < 2)
+                argp_usage(state);
+            break;
+        default: return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+static void fail(const char* msg) {
+    printf("%s\n", msg);
+    exit(1);
+}
+
+// A pair of graphs, its features and the time of every engine on it, NAN
+// where the engine was not run
+typedef struct pair_s {
+    char *file1, *file2;
+    double features[N_FEATURES];
+    double *time;
+}pair_t;
+
+static pair_t *pairs;
+static int n_pairs;
+static char **engines;              // engine and options, as in a rule
+static int n_engines;
+
+static pair_t *find_pair(const char *file1, const char *file2) {
+    for (int i = 0; i < n_pairs; i++)
+        if (strcmp(pairs[i].file1, file1) == 0 && strcmp(pairs[i].file2, file2) == 0)
+            return &pairs[i];
+    return NULL;
+}
+
+static int engine_index(const char *engine) {
+    for (int e = 0; e < n_engines; e++)
+        if (strcmp(engines[e], engine) == 0)
+            return e;
+    engines = realloc(engines, (n_engines + 1) * sizeof *engines);
+    engines[n_engines] = strdup(engine);
+    for (int i = 0; i < n_pairs; i++) {
+        pairs[i].time = realloc(pairs[i].time, (n_engines + 1) * sizeof *pairs[i].time);
+        pairs[i].time[n_engines] = NAN;
+    }
+    return n_engines++;
+}
+
+// Splits line at sep, without merging empty fields as strtok would
+static int split(char *line, char sep, char **fields, int max_fields) {
+    int n = 0;
+    while (n < max_fields) {
+        fields[n++] = line;
+        line = strchr(line, sep);
+        if (line == NULL) break;
+        *line++ = '\0';
+    }
+    return n;
+}
+
+static void read_features(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+        fail("Cannot open the features file");
+    char *line = NULL, *fields[MAX_FIELDS];
+    size_t size = 0;
+    int column[MAX_FIELDS], n_columns = 0;     // feature of each column, -1 if unknown
+    while (getline(&line, &size, f) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        int n = split(line, ',', fields, MAX_FIELDS);
+        if (strcmp(fields[0], "file1") == 0) {
+            n_columns = n;
+            for (int c = 2; c < n; c++)
+                column[c] = feature_index(fields[c]);
+            continue;
+        }
+        if (n_columns == 0)
+            fail("The features file does not start with a header line");
+        if (n != n_columns || find_pair(fields[0], fields[1]) != NULL) {
+            fprintf(stderr, "Bad or repeated line for %s %s, skipped\n", fields[0], n > 1 ? fields[1] : "");
+            continue;
+        }
+        pairs = realloc(pairs, (n_pairs + 1) * sizeof *pairs);
+        pair_t *p = &pairs[n_pairs++];
+        p->file1 = strdup(fields[0]);
+        p->file2 = strdup(fields[1]);
+        for (int i = 0; i < N_FEATURES; i++) p->features[i] = 0;
+        for (int c = 2; c < n; c++)
+            if (column[c] != -1) p->features[column[c]] = strtod(fields[c], NULL);
+        p->time = malloc((n_engines + 1) * sizeof *p->time);
+        for (int e = 0; e < n_engines; e++) p->time[e] = NAN;
+    }
+    free(line);
+    fclose(f);
+}
+
+static void read_times(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+        fail("Cannot open the times file");
+    char *line = NULL;
+    size_t size = 0;
+    while (getline(&line, &size, f) != -1) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        char file1[4096], file2[4096];
+        double seconds;
+        int len;
+        if (sscanf(line, " %4095s %4095s %lf %n", file1, file2, &seconds, &len) != 3 || line[len] == '\0') {
+            if (line[strspn(line, " \t")] != '\0')
+                fprintf(stderr, "Bad line '%s', skipped\n", line);
+            continue;
+        }
+        pair_t *p = find_pair(file1, file2);
+        if (p == NULL) {
+            fprintf(stderr, "No features for %s %s, skipped\n", file1, file2);
+            continue;
+        }
+        char *engine = line + len;
+        for (size_t end = strlen(engine); end > 0 && (engine[end - 1] == ' ' || engine[end - 1] == '\t'); end--)
+            engine[end - 1] = '\0';
+        int e = engine_index(engine);
+        if (isnan(p->time[e]) || seconds < p->time[e])
+            p->time[e] = seconds;
+    }
+    free(line);
+    fclose(f);
+}
+
+// Drops the pairs with no time, and charges the engines not run on a pair
+// with the slowest time on it, so that they are never preferred there
+static void fill_missing_times() {
+    int kept = 0;
+    for (int i = 0; i < n_pairs; i++) {
+        double worst = NAN;
+        for (int e = 0; e < n_engines; e++)
+            if (!isnan(pairs[i].time[e]) && (isnan(worst) || pairs[i].time[e] > worst))
+                worst = pairs[i].time[e];
+        if (isnan(worst)) {
+            free(pairs[i].file1);
+            free(pairs[i].file2);
+            free(pairs[i].time);
+            continue;
+        }
+        for (int e = 0; e < n_engines; e++)
+            if (isnan(pairs[i].time[e])) pairs[i].time[e] = worst;
+        pairs[kept++] = pairs[i];
+    }
+    n_pairs = kept;
+}
+
+// FIT /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Greedy decision list: among the pairs no rule covers yet, each round takes
+// the condition FEATURE <= T or FEATURE > T, with T halfway between two
+// values, and the engine that saves the most time over the fastest engine
+// overall on the pairs it covers. The rule is added and its pairs removed.
+
+typedef struct fit_s {
+    double gain;
+    int feature;
+    bool above;
+    double threshold;
+    int engine;
+}fit_t;
+
+static int sort_feature;
+
+static int by_feature(const void *a, const void *b) {
+    double x = pairs[*(const int *)a].features[sort_feature], y = pairs[*(const int *)b].features[sort_feature];
+    return (x > y) - (x < y);
+}
+
+static int fastest_engine(int *left, int n) {
+    int best = 0;
+    double best_time = INFINITY;
+    for (int e = 0; e < n_engines; e++) {
+        double t = 0;
+        for (int i = 0; i < n; i++) t += pairs[left[i]].time[e];
+        if (t < best_time) {
+            best_time = t;
+            best = e;
+        }
+    }
+    return best;
+}
+
+// Best engine and its gain over def on n pairs whose times add up to sum
+static void try_side(fit_t *best, double *sum, int n, int def, int f, bool above, double threshold) {
+    if (n < arguments.min_pairs) return;
+    for (int e = 0; e < n_engines; e++)
+        if (sum[def] - sum[e] > best->gain) {
+            best->gain = sum[def] - sum[e];
+            best->feature = f;
+            best->above = above;
+            best->threshold = threshold;
+            best->engine = e;
+        }
+}
+
+static fit_t best_rule(int *left, int n, int def) {
+    fit_t best = { 1e-9, -1 };      // a rule has to save something
+    double *below = malloc(n_engines * sizeof *below), *above = malloc(n_engines * sizeof *above);
+    for (int f = 0; f < N_FEATURES; f++) {
+        sort_feature = f;
+        qsort(left, n, sizeof *left, by_feature);
+        for (int e = 0; e < n_engines; e++) {
+            below[e] = 0;
+            above[e] = 0;
+            for (int i = 0; i < n; i++) above[e] += pairs[left[i]].time[e];
+        }
+        for (int k = 1; k < n; k++) {
+            for (int e = 0; e < n_engines; e++) {
+                below[e] += pairs[left[k - 1]].time[e];
+                above[e] -= pairs[left[k - 1]].time[e];
+            }
+            double x = pairs[left[k - 1]].features[f], y = pairs[left[k]].features[f];
+            if (x == y) continue;
+            try_side(&best, below, k, def, f, false, (x + y) / 2);
+            try_side(&best, above, n - k, def, f, true, (x + y) / 2);
+        }
+    }
+    free(below);
+    free(above);
+    return best;
+}
+
+static bool holds(fit_t *r, pair_t *p) {
+    return r->above ? p->features[r->feature] > r->threshold : p->features[r->feature] <= r->threshold;
+}
+
+// Shortest printing of the threshold that still falls between the same values
+static void print_threshold(fit_t *r, int *left, int n) {
+    char buf[32];
+    for (int digits = 6; digits <= 17; digits++) {
+        snprintf(buf, sizeof buf, "%.*g", digits, r->threshold);
+        fit_t printed = *r;
+        printed.threshold = strtod(buf, NULL);
+        int i = 0;
+        while (i < n && holds(&printed, &pairs[left[i]]) == holds(r, &pairs[left[i]])) i++;
+        if (i == n) break;
+    }
+    printf("%s", buf);
+}
+
+int main(int argc, char** argv) {
+    arguments.max_rules = 8;
+    arguments.min_pairs = 3;
+    argp_parse(&argp, argc, argv, 0, 0, 0);
+
+    read_features(arguments.features);
+    read_times(arguments.times);
+    fill_missing_times();
+    if (n_pairs == 0)
+        fail("*** Error: no pair has both features and times");
+
+    int *left = malloc(n_pairs * sizeof *left), n = n_pairs;
+    for (int i = 0; i < n_pairs; i++) left[i] = i;
+    int overall = fastest_engine(left, n);
+    double list_time = 0, overall_time = 0, oracle_time = 0;
+    for (int i = 0; i < n_pairs; i++) {
+        double best = INFINITY;
+        for (int e = 0; e < n_engines; e++)
+            if (pairs[i].time[e] < best) best = pairs[i].time[e];
+        oracle_time += best;
+        overall_time += pairs[i].time[overall];
+    }
+
+    printf("# %d pairs, %d engines\n", n_pairs, n_engines);
+    for (int r = 0; r < arguments.max_rules && n > 0; r++) {
+        int def = fastest_engine(left, n);
+        fit_t rule = best_rule(left, n, def);
+        if (rule.feature == -1) break;
+        printf("%s %s ", feature_names[rule.feature], rule.above ? ">" : "<=");
+        print_threshold(&rule, left, n);
+        printf(" : %s\n", engines[rule.engine]);
+        int kept = 0;
+        for (int i = 0; i < n; i++) {
+            if (holds(&rule, &pairs[left[i]]))
+                list_time += pairs[left[i]].time[rule.engine];
+            else
+                left[kept++] = left[i];
+        }
+        n = kept;
+    }
+    int def = n > 0 ? fastest_engine(left, n) : overall;
+    for (int i = 0; i < n; i++) list_time += pairs[left[i]].time[def];
+    printf(": %s\n", engines[def]);
+    printf("# total seconds: %g with these rules, %g with %s alone, %g with the fastest engine of each pair\n",
+           list_time, overall_time, engines[overall], oracle_time);
+
+    free(left);
+    for (int i = 0; i < n_pairs; i++) {
+        free(pairs[i].file1);
+        free(pairs[i].file2);
+        free(pairs[i].time);
+    }
+    free(pairs);
+    for (int e = 0; e < n_engines; e++) free(engines[e]);
+    free(engines);
+    return 0;
+}
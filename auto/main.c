@@ -0,0 +1,261 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#define _GNU_SOURCE
+
+#include "features.h"
+#include "graph.h"
+
+#include <argp.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Front-end that reads the two graphs, computes cheap instance features and
+// runs the engine chosen by a decision list of rules on them.
+
+static void fail(char* msg) {
+    printf("%s\n", msg);
+    exit(1);
+}
+
+// Used when no rules file is given: v4 for what fits its static buffers,
+// the dedicated connected engine of v1 for connected queries, the sparse
+// engine of v1 for large sparse graphs, v2 otherwise.
+static const char default_rules[] =
+    "connected = 1 : v1\n"
+    "n_max <= 64 n_min <= 16 : v4 -s 3\n"
+    "n_max <= 64 : v4\n"
+    "n_max >= 1000 density_max <= 0.05 : v1\n"
+    ": v2\n";
+
+typedef struct engine_s {
+    const char *name;
+    const char *path;       // relative to the engines directory
+    int max_n;              // largest graph the engine can hold
+    bool has_quiet;
+}engine_t;
+
+static const engine_t engines[] = {
+    {"v1", "v1/v1_trimble_seq_c", INT_MAX, true},
+    {"v2", "v2/v2_trimble_par_c", INT_MAX, true},
+    {"v3", "v3/v3_iterative_seq_c", UCHAR_MAX - 1, true},
+    {"v4", "v4/v4_iterative_par_c", 64, true},
+    {"v5", "v5/v5_iterative_gpu_c", 64, false},
+};
+#define N_ENGINES (sizeof engines / sizeof engines[0])
+
+static char doc[] = "Run the engine best suited to a pair of graphs";
+static char args_doc[] = "FILENAME1 FILENAME2";
+static struct argp_option options[] = {
+        {"quiet", 'q', 0, 0, "Quiet output"},
+        {"verbose", 'v', 0, 0, "Verbose output, prints the features and the chosen command"},
+        {"lad", 'l', 0, 0, "Read LAD format"},
+        {"labelled", 'L', 0, 0, "Match the vertex and edge labels of binary files"},
+        {"directed", 'i', 0, 0, "Read the graphs as directed, and match arcs with arcs of the same direction"},
+        {"timeout", 't', "timeout", 0, "Set timeout of TIMEOUT seconds"},
+        {"connected", 'c', 0, 0, "Solve max common CONNECTED subgraph problem"},
+        {"at-least", 'a', "K", 0, "Stop as soon as a common subgraph of K vertices is found, or proven not to exist"},
+        {"ratio", 'r', "R", 0, "Same as --at-least with K = R * min(n0,n1), rounded up"},
+        {"rules", 'f', "FILE", 0, "Read the decision rules from FILE"},
+        {"engines", 'e', "DIR", 0, "Directory holding v1 ... v5 (default: the parent of this program's directory)"},
+        {"features", 'x', 0, 0, "Print the features as a CSV line and exit"},
+        {"dry-run", 'd', 0, 0, "Print the chosen command and exit"},
+        { 0 }
+};
+
+static struct {
+    bool quiet;
+    bool verbose;
+    bool lad;
+    bool labelled;
+    bool directed;
+    bool connected;
+    bool features;
+    bool dry_run;
+    char *timeout;
+    char *at_least;
+    char *ratio;
+    char *rules;
+    char *engines;
+    char *filename1;
+    char *filename2;
+    int arg_num;
+} arguments;
+
+void set_default_arguments() {
+    memset(&arguments, 0, sizeof arguments);
+}
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+    switch (key) {
+        case 'q':
+            arguments.quiet = true;
+            break;
+        case 'v':
+            arguments.verbose = true;
+            break;
+        case 'l':
+            arguments.lad = true;
+            break;
+        case 'L':
+            arguments.labelled = true;
+            break;
+        case 'i':
+            arguments.directed = true;
+            break;
+        case 't':
+            arguments.timeout = arg;
+            break;
+        case 'c':
+            arguments.connected = true;
+            break;
+        case 'a':
+            arguments.at_least = arg;
+            break;
+        case 'r':
+            arguments.ratio = arg;
+            break;
+        case 'f':
+            arguments.rules = arg;
+            break;
+        case 'e':
+            arguments.engines = arg;
+            break;
+        case 'x':
+            arguments.features = true;
+            break;
+        case 'd':
+            arguments.dry_run = true;
+            break;
+        case ARGP_KEY_ARG:
+            if (arguments.arg_num == 0) {
+                arguments.filename1 = arg;
+            } else if (arguments.arg_num == 1) {
+                arguments.filename2 = arg;
+            } else {
+                argp_usage(state);
+            }
+            arguments.arg_num++;
+            break;
+        case ARGP_KEY_END:
+            if (arguments.arg_num < 2)
+                argp_usage(state);
+            break;
+        default: return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+const engine_t *find_engine(const char *name) {
+    for (unsigned int i = 0; i < N_ENGINES; i++)
+        if (strcmp(engines[i].name, name) == 0)
+            return &engines[i];
+    return NULL;
+}
+
+// First rule that matches and names an engine able to hold the instance
+rule_t *choose_rule(rule_list_t *rules, double *features) {
+    for (unsigned int r = 0; r < rules->len; r++) {
+        const engine_t *engine = find_engine(rules->vals[r].engine);
+        if (engine == NULL) {
+            fprintf(stderr, "Unknown engine %s, rule skipped\n", rules->vals[r].engine);
+            continue;
+        }
+        if (features[F_N_MAX] <= engine->max_n && rule_matches(&rules->vals[r], features))
+            return &rules->vals[r];
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    set_default_arguments();
+    argp_parse(&argp, argc, argv, 0, 0, 0);
+
+    char format = arguments.lad ? 'L' : 'B';
+    sparse_graph_t *g0 = calloc(1, sizeof *g0);
+    readSparseGraph(arguments.filename1, g0, format, arguments.directed, arguments.labelled);
+    sparse_graph_t *g1 = calloc(1, sizeof *g1);
+    readSparseGraph(arguments.filename2, g1, format, arguments.directed, arguments.labelled);
+
+    double features[N_FEATURES];
+    compute_features(g0, g1, arguments.connected, features);
+    free_sparse_graph(g0);
+    free_sparse_graph(g1);
+
+    if (arguments.features || arguments.verbose) {
+        printf("file1,file2");
+        for (int i = 0; i < N_FEATURES; i++) printf(",%s", feature_names[i]);
+        printf("\n%s,%s", arguments.filename1, arguments.filename2);
+        for (int i = 0; i < N_FEATURES; i++) printf(",%g", features[i]);
+        printf("\n");
+        if (arguments.features) return 0;
+    }
+
+    rule_list_t *rules = arguments.rules ? read_rules(arguments.rules) : parse_rules(default_rules);
+    rule_t *rule = choose_rule(rules, features);
+    if (rule == NULL)
+        fail("*** Error: no rule matches the instance");
+    const engine_t *engine = find_engine(rule->engine);
+
+    char engines_dir[PATH_MAX];
+    if (arguments.engines) {
+        snprintf(engines_dir, sizeof engines_dir, "%s", arguments.engines);
+    } else {
+        char self[PATH_MAX];
+        snprintf(self, sizeof self, "%s", argv[0]);
+        snprintf(engines_dir, sizeof engines_dir, "%s/..", dirname(self));
+    }
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof path, "%s/%s", engines_dir, engine->path);
+
+    // engine, rule options, forwarded options, the two graphs
+    char *engine_argv[MAX_ENGINE_ARGS + 16];
+    int n = 0;
+    engine_argv[n++] = path;
+    for (unsigned int a = 0; a < rule->n_args; a++) engine_argv[n++] = rule->args[a];
+    if (arguments.quiet && engine->has_quiet) engine_argv[n++] = "-q";
+    if (arguments.verbose) engine_argv[n++] = "-v";
+    if (arguments.lad) engine_argv[n++] = "-l";
+    if (arguments.labelled) engine_argv[n++] = "-L";
+    if (arguments.directed) engine_argv[n++] = "-i";
+    if (arguments.connected) engine_argv[n++] = "-c";
+    if (arguments.timeout) { engine_argv[n++] = "-t"; engine_argv[n++] = arguments.timeout; }
+    if (arguments.at_least) { engine_argv[n++] = "-a"; engine_argv[n++] = arguments.at_least; }
+    if (arguments.ratio) { engine_argv[n++] = "-r"; engine_argv[n++] = arguments.ratio; }
+    engine_argv[n++] = arguments.filename1;
+    engine_argv[n++] = arguments.filename2;
+    engine_argv[n] = NULL;
+
+    if (arguments.verbose || arguments.dry_run) {
+        for (int i = 0; i < n; i++) printf("%s ", engine_argv[i]);
+        printf("\n");
+        if (arguments.dry_run) return 0;
+    }
+    fflush(stdout);
+    execv(path, engine_argv);
+    fprintf(stderr, "*** Error: cannot run %s: %s\n", path, strerror(errno));
+    return 1;
+}
@@ -0,0 +1,226 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "clique.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_BITS 64
+
+typedef unsigned long long word_t;
+
+// The product graph and the state of the search. Product vertices are
+// renumbered by non-increasing degree, so that the lowest set bit of a
+// candidate set is its vertex of highest degree.
+typedef struct clique_s {
+    unsigned int n;             // product vertices
+    unsigned int words;         // words per bitset
+    word_t *adj;                // n bitsets
+    int *pair_v, *pair_w;       // product vertex -> (v, w)
+    word_t *candidates;         // one bitset per depth
+    unsigned int *order;        // one colouring order per depth
+    unsigned int *colour;       // one colour bound per depth
+    unsigned int *current, current_len;
+    unsigned int *best, best_len;
+    unsigned int floor;
+    bool (*stop)(unsigned int);
+    bool verbose;
+    bool stopped;
+}clique_t;
+
+static inline void set_bit(word_t *set, unsigned int i) {
+    set[i / WORD_BITS] |= 1ULL << (i % WORD_BITS);
+}
+
+static inline void unset_bit(word_t *set, unsigned int i) {
+    set[i / WORD_BITS] &= ~(1ULL << (i % WORD_BITS));
+}
+
+static inline bool test_bit(const word_t *set, unsigned int i) {
+    return (set[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+}
+
+// Index of the lowest set bit of set, starting from word `from`; n if empty
+static inline unsigned int first_bit(const word_t *set, unsigned int words, unsigned int from, unsigned int n) {
+    for (unsigned int k = from; k < words; k++)
+        if (set[k])
+            return k * WORD_BITS + __builtin_ctzll(set[k]);
+    return n;
+}
+
+static unsigned int popcount(const word_t *set, unsigned int words) {
+    unsigned int count = 0;
+    for (unsigned int k = 0; k < words; k++)
+        count += __builtin_popcountll(set[k]);
+    return count;
+}
+
+static void build_product(clique_t *c, graph_t *g0, graph_t *g1) {
+    unsigned int max_n = g0->n * g1->n, n = 0;
+    int *pair_v = malloc(max_n * sizeof *pair_v);
+    int *pair_w = malloc(max_n * sizeof *pair_w);
+    for (int v = 0; v < g0->n; v++)
+        for (int w = 0; w < g1->n; w++)
+            if (g0->label[v] == g1->label[w]) {
+                pair_v[n] = v;
+                pair_w[n] = w;
+                n++;
+            }
+
+    // degree of every product vertex, then sort by non-increasing degree
+    unsigned int *degree = calloc(n, sizeof *degree);
+    for (unsigned int i = 0; i < n; i++)
+        for (unsigned int j = i + 1; j < n; j++)
+            if (pair_v[i] != pair_v[j] && pair_w[i] != pair_w[j] &&
+                    g0->adjmat[pair_v[i]][pair_v[j]] == g1->adjmat[pair_w[i]][pair_w[j]]) {
+                degree[i]++;
+                degree[j]++;
+            }
+    unsigned int *vv = malloc(n * sizeof *vv);
+    for (unsigned int i = 0; i < n; i++) vv[i] = i;
+    INSERTION_SORT(unsigned int, vv, (int)n, degree[vv[j-1]] < degree[vv[j]]);
+
+    c->n = n;
+    c->words = (n + WORD_BITS - 1) / WORD_BITS;
+    if (c->words == 0) c->words = 1;
+    c->pair_v = malloc(n * sizeof *c->pair_v);
+    c->pair_w = malloc(n * sizeof *c->pair_w);
+    for (unsigned int i = 0; i < n; i++) {
+        c->pair_v[i] = pair_v[vv[i]];
+        c->pair_w[i] = pair_w[vv[i]];
+    }
+    c->adj = calloc((size_t)n * c->words, sizeof *c->adj);
+    for (unsigned int i = 0; i < n; i++)
+        for (unsigned int j = i + 1; j < n; j++)
+            if (c->pair_v[i] != c->pair_v[j] && c->pair_w[i] != c->pair_w[j] &&
+                    g0->adjmat[c->pair_v[i]][c->pair_v[j]] == g1->adjmat[c->pair_w[i]][c->pair_w[j]]) {
+                set_bit(&c->adj[(size_t)i * c->words], j);
+                set_bit(&c->adj[(size_t)j * c->words], i);
+            }
+    free(pair_v);
+    free(pair_w);
+    free(degree);
+    free(vv);
+}
+
+// Greedy sequential colouring of the candidates of a depth: order[] lists the
+// candidates colour class by colour class, colour[i] is the number of colours
+// used up to order[i], hence a bound on any clique within order[0..i].
+static unsigned int colour_candidates(clique_t *c, unsigned int depth, word_t *uncoloured, word_t *q) {
+    word_t *p = &c->candidates[(size_t)depth * c->words];
+    unsigned int *order = &c->order[(size_t)depth * c->n];
+    unsigned int *colour = &c->colour[(size_t)depth * c->n];
+    unsigned int len = 0, k = 0;
+    memcpy(uncoloured, p, c->words * sizeof *uncoloured);
+    for (unsigned int from = 0; (from = first_bit(uncoloured, c->words, from / WORD_BITS, c->n) ) < c->n; ) {
+        k++;
+        memcpy(q, uncoloured, c->words * sizeof *q);
+        for (unsigned int v = from; v < c->n; v = first_bit(q, c->words, v / WORD_BITS, c->n)) {
+            unset_bit(uncoloured, v);
+            unset_bit(q, v);
+            const word_t *nv = &c->adj[(size_t)v * c->words];
+            for (unsigned int w = v / WORD_BITS; w < c->words; w++)
+                q[w] &= ~nv[w];
+            order[len] = v;
+            colour[len] = k;
+            len++;
+        }
+    }
+    return len;
+}
+
+static void expand(clique_t *c, unsigned int depth, word_t *scratch) {
+    word_t *p = &c->candidates[(size_t)depth * c->words];
+    word_t *new_p = &c->candidates[(size_t)(depth + 1) * c->words];
+    unsigned int *order = &c->order[(size_t)depth * c->n];
+    unsigned int *colour = &c->colour[(size_t)depth * c->n];
+    unsigned int len = colour_candidates(c, depth, scratch, scratch + c->words);
+    unsigned int to_beat = c->best_len > c->floor ? c->best_len : c->floor;
+
+    for (int i = len - 1; i >= 0; i--) {
+        if (c->current_len + colour[i] <= to_beat) return;
+        if (c->stop(c->best_len)) {
+            c->stopped = true;
+            return;
+        }
+        unsigned int v = order[i];
+        c->current[c->current_len++] = v;
+        const word_t *nv = &c->adj[(size_t)v * c->words];
+        bool empty = true;
+        for (unsigned int w = 0; w < c->words; w++) {
+            new_p[w] = p[w] & nv[w];
+            empty &= new_p[w] == 0;
+        }
+        if (empty) {
+            if (c->current_len > c->best_len) {
+                c->best_len = c->current_len;
+                memcpy(c->best, c->current, c->best_len * sizeof *c->best);
+                if (c->verbose) printf("clique incumbent %d\n", c->best_len);
+            }
+        } else {
+            expand(c, depth + 1, scratch);
+        }
+        c->current_len--;
+        if (c->stopped) return;
+        unset_bit(p, v);
+        to_beat = c->best_len > c->floor ? c->best_len : c->floor;
+    }
+}
+
+unsigned int clique_mcs(graph_t *g0, graph_t *g1, unsigned int floor, bool (*stop)(unsigned int), bool verbose, int *sol) {
+    clique_t c;
+    memset(&c, 0, sizeof c);
+    build_product(&c, g0, g1);
+    unsigned int max_depth = (g0->n < g1->n ? g0->n : g1->n) + 1;
+    c.candidates = calloc((size_t)(max_depth + 1) * c.words, sizeof *c.candidates);
+    c.order = malloc((size_t)max_depth * c.n * sizeof *c.order + 1);
+    c.colour = malloc((size_t)max_depth * c.n * sizeof *c.colour + 1);
+    c.current = malloc(max_depth * sizeof *c.current);
+    c.best = malloc(max_depth * sizeof *c.best);
+    c.floor = floor;
+    c.stop = stop;
+    c.verbose = verbose;
+    word_t *scratch = malloc(2 * c.words * sizeof *scratch);
+    if (c.adj == NULL || c.candidates == NULL || c.order == NULL || c.colour == NULL) {
+        printf("Cannot allocate the product graph\n");
+        exit(1);
+    }
+    if (verbose) printf("product graph: %u vertices, %u edges\n", c.n, popcount(c.adj, c.n * c.words) / 2);
+
+    for (unsigned int i = 0; i < c.n; i++)
+        set_bit(c.candidates, i);
+    if (c.n > 0)
+        expand(&c, 0, scratch);
+
+    for (unsigned int i = 0; i < c.best_len; i++) {
+        sol[2 * i] = c.pair_v[c.best[i]];
+        sol[2 * i + 1] = c.pair_w[c.best[i]];
+    }
+    free(scratch);
+    free(c.adj);
+    free(c.pair_v);
+    free(c.pair_w);
+    free(c.candidates);
+    free(c.order);
+    free(c.colour);
+    free(c.current);
+    free(c.best);
+    return c.best_len;
+}
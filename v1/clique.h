@@ -0,0 +1,37 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef CLIQUE_H_
+#define CLIQUE_H_
+
+#include "graph.h"
+
+#include <stdbool.h>
+
+// Maximum common induced subgraph as a maximum clique of the modular product
+// graph: vertex (v,w) for every pair of equally labelled vertices, and an edge
+// between (v,w) and (v',w') when v != v', w != w' and adjmat0[v][v'] equals
+// adjmat1[w][w']. The clique search is bit-parallel, bounded by a greedy
+// colouring of the candidate set.
+//
+// Branches that cannot beat max(incumbent, floor) are pruned, and the search
+// returns as soon as stop() is true; stop() is given the incumbent size.
+// The mapping is stored in sol as v0 w0 v1 w1 ..., its size is returned.
+unsigned int clique_mcs(graph_t *g0, graph_t *g1, unsigned int floor, bool (*stop)(unsigned int), bool verbose, int *sol);
+
+#endif /* CLIQUE_H_ */
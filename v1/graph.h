@@ -38,31 +38,80 @@
 
 typedef unsigned long long ULL;
 
+#define EDGE_LABEL_BITS 7      // so that 1 + an edge label fits in a byte of adjmat
+#define ARC_LABEL_BITS 3       // and in half a byte for the arcs of directed graphs
+
 typedef struct graph_s {
     int n;
     unsigned char **adjmat;
     unsigned int *label;
     unsigned int *degree;
+    unsigned int *twin;
 }graph_t;
 
+// Compressed sparse rows: the neighbours of v, successors and predecessors
+// alike, are adj[offset[v]] ... adj[offset[v+1]-1] in increasing order, and
+// value[k] is what adjmat[v][adj[k]] holds in the dense graph. A graph of n
+// vertices and m edges takes O(n + m) memory instead of n*n bytes.
+typedef struct sparse_graph_s {
+    int n;
+    unsigned int *offset;
+    int *adj;
+    unsigned char *value;
+    unsigned int *label;
+    unsigned int *twin;
+}sparse_graph_t;
+
+// Sets g->n and allocates zeroed labels and adjacency matrix
+void alloc_graph(graph_t *g, int n);
+
 unsigned int* calculate_degrees(graph_t *g);
 
+unsigned int* calculate_twins(graph_t *g);
+
+// A copy of g renumbered so that vertex i is vertex vv[i] of g, whose
+// degrees are moved rather than counted
 graph_t *induced_subgraph(graph_t *g, int *vv);
 
 int graph_edge_count(graph_t *g);
 
+// format is 'B' (binary) or 'L' (LAD); the labels of binary files are
+// only read if labelled
+// Precondition: *g is already zeroed out
+void readGraph(char* filename, graph_t* g, char format, bool directed, bool labelled);
+
+// As readGraph, without building the adjacency matrix
 // Precondition: *g is already zeroed out
-void readGraph(char* filename, graph_t* g, char format);
+void readSparseGraph(char* filename, sparse_graph_t* g, char format, bool directed, bool labelled);
 
 // Precondition: *g is already zeroed out
-void readBinaryGraph(char* filename, graph_t* g);
+void readBinaryGraph(char* filename, sparse_graph_t* g, bool directed, bool labelled);
 
 // Precondition: *g is already zeroed out
-void readLadGraph(char* filename, graph_t* g);
+void readLadGraph(char* filename, sparse_graph_t* g, bool directed);
 
 void free_graph(graph_t *g);
 
+// Renumbers g in place so that vertex i is vertex vv[i] of g
+void permute_graph(graph_t *g, int *vv);
+
+// Sorts g in place by degree and returns it
 graph_t *sort_vertices_by_degree(graph_t *g, bool ascending );
 
+// The vertices by degree, ties by index
+int *degree_order(unsigned int *degree, int n, bool ascending);
+
+graph_t *dense_graph(sparse_graph_t *g);
+
+void free_sparse_graph(sparse_graph_t *g);
+
+unsigned int sparse_edge_count(sparse_graph_t *g);
+
+unsigned char sparse_value(sparse_graph_t *g, int v, int w);
+
+unsigned int* calculate_sparse_twins(sparse_graph_t *g);
+
+sparse_graph_t *sort_sparse_vertices_by_degree(sparse_graph_t *g, bool ascending);
+
 #endif /* GRAPH_H_ */
 
@@ -19,11 +19,15 @@
 #define _GNU_SOURCE
 #define _POSIX_SOURCE
 
+#include "clique.h"
 #include "graph.h"
+#include "nogood.h"
+#include "sparse.h"
 
 #include <argp.h>
 #include <limits.h>
 #include <locale.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +39,9 @@ typedef unsigned long long ULL;
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
 
+#define OPT_SPARSE 256      // long options only, -S and -D mean --server and --db in v4
+#define OPT_DENSE 257
+
 void swap(int *a, int *b) {
     int tmp = *a;
     *a = *b;
@@ -51,8 +58,21 @@ static struct argp_option options[] = {
         {"quiet", 'q', 0, 0, "Quiet output"},
         {"verbose", 'v', 0, 0, "Verbose output"},
         {"lad", 'l', 0, 0, "Read LAD format"},
+        {"labelled", 'L', 0, 0, "Match the vertex and edge labels of binary files"},
+        {"directed", 'i', 0, 0, "Read the graphs as directed, and match arcs with arcs of the same direction"},
         {"timeout", 't', "timeout", 0, "Set timeout of TIMEOUT seconds"},
         {"connected", 'c', 0, 0, "Solve max common CONNECTED subgraph problem"},
+        {"nogood-cache", 'g', "MB", 0, "Cache failed subproblems in a table of MB megabytes"},
+        {"best-first", 'b', "MB", 0, "Best-first search with a frontier of at most MB megabytes"},
+        {"lds", 'd', "K", 0, "Run limited discrepancy search with up to K discrepancies before the exact search"},
+        {"beam", 'w', "WIDTH", 0, "Run beam search of width WIDTH before the exact search"},
+        {"at-least", 'a', "K", 0, "Stop as soon as a common subgraph of K vertices is found, or proven not to exist"},
+        {"ratio", 'r', "R", 0, "Same as --at-least with K = R * min(n0,n1), rounded up"},
+        {"clique", 'p', 0, 0, "Solve as maximum clique on the modular product graph"},
+        {"estimate", 'e', "PROBES", 0, "Estimate the search tree size with PROBES random probes, then report progress while solving"},
+        {"estimate-only", 'E', 0, 0, "Print the tree size estimate and exit without solving"},
+        {"sparse", OPT_SPARSE, 0, 0, "Solve on adjacency lists, the default for large sparse graphs"},
+        {"dense", OPT_DENSE, 0, 0, "Solve on adjacency matrices, whatever the size and density"},
         { 0 }
 };
 
@@ -61,7 +81,20 @@ static struct {
     bool verbose;
     bool connected;
     bool lad;
+    bool labelled;
+    bool directed;
     int timeout;
+    int nogood_mb;
+    int best_first_mb;
+    int lds;
+    int beam;
+    int at_least;
+    double ratio;
+    bool clique;
+    int estimate;
+    bool estimate_only;
+    bool sparse;
+    bool dense;
     char *filename1;
     char *filename2;
     int arg_num;
@@ -72,7 +105,20 @@ void set_default_arguments() {
     arguments.verbose = false;
     arguments.connected = false;
     arguments.lad = false;
+    arguments.labelled = false;
+    arguments.directed = false;
     arguments.timeout = 0;
+    arguments.nogood_mb = 0;
+    arguments.best_first_mb = 0;
+    arguments.lds = -1;
+    arguments.beam = 0;
+    arguments.at_least = 0;
+    arguments.ratio = 0;
+    arguments.clique = false;
+    arguments.estimate = 0;
+    arguments.estimate_only = false;
+    arguments.sparse = false;
+    arguments.dense = false;
     arguments.filename1 = NULL;
     arguments.filename2 = NULL;
     arguments.arg_num = 0;
@@ -83,6 +129,12 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
         case 'l':
             arguments.lad = true;
             break;
+        case 'L':
+            arguments.labelled = true;
+            break;
+        case 'i':
+            arguments.directed = true;
+            break;
         case 'q':
             arguments.quiet = true;
             break;
@@ -95,6 +147,39 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
         case 'c':
             arguments.connected = true;
             break;
+        case 'g':
+            arguments.nogood_mb = strtol(arg, NULL, 10);
+            break;
+        case 'b':
+            arguments.best_first_mb = strtol(arg, NULL, 10);
+            break;
+        case 'd':
+            arguments.lds = strtol(arg, NULL, 10);
+            break;
+        case 'w':
+            arguments.beam = strtol(arg, NULL, 10);
+            break;
+        case 'a':
+            arguments.at_least = strtol(arg, NULL, 10);
+            break;
+        case 'r':
+            arguments.ratio = strtod(arg, NULL);
+            break;
+        case 'p':
+            arguments.clique = true;
+            break;
+        case 'e':
+            arguments.estimate = strtol(arg, NULL, 10);
+            break;
+        case 'E':
+            arguments.estimate_only = true;
+            break;
+        case OPT_SPARSE:
+            arguments.sparse = true;
+            break;
+        case OPT_DENSE:
+            arguments.dense = true;
+            break;
         case ARGP_KEY_ARG:
             if (arguments.arg_num == 0) {
                 arguments.filename1 = arg;
@@ -108,6 +193,12 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
         case ARGP_KEY_END:
             if (arguments.arg_num == 0)
                 argp_usage(state);
+            if (arguments.clique && arguments.connected)
+                fail("*** Error: the clique engine does not support --connected");
+            if (arguments.clique && (arguments.estimate > 0 || arguments.estimate_only))
+                fail("*** Error: the clique engine does not support --estimate and --estimate-only");
+            if (arguments.nogood_mb > 0 && arguments.connected)
+                fail("*** Error: --nogood-cache does not support --connected");
             break;
         default: return ARGP_ERR_UNKNOWN;
     }
@@ -116,6 +207,11 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 
 static struct argp argp = { options, parse_opt, args_doc, doc };
 struct timespec start;
+nogood_cache_t *nogood = NULL;
+int *domain_of = NULL;   // scratch buffer of encode_domains, one entry per vertex of g0
+int threshold = 0;       // --at-least/--ratio: stop at the first mapping of this size, 0 to search for the optimum
+unsigned char *reach0 = NULL, *reach1 = NULL;   // scratch buffers of calc_connected_bound, one entry per vertex
+int *reach_queue = NULL, *reach_pending = NULL;
 
 typedef struct vtx_pair_s {
     int v;
@@ -158,6 +254,16 @@ int calc_bound(bidomain_list_t *domains) {
     return bound;
 }
 
+// Size a branch has to beat to be worth exploring: with a threshold, a branch
+// that cannot reach it is as useless as one that cannot beat the incumbent.
+int to_beat(mapping_t *incumbent){
+    return threshold ? MAX((int)incumbent->len, threshold - 1) : incumbent->len;
+}
+
+bool threshold_reached(mapping_t *incumbent){
+    return threshold && incumbent->len >= threshold;
+}
+
 void set_incumbent(mapping_t *current, mapping_t *incumbent){
     incumbent->len = current->len;
     if(arguments.verbose) printf("new Incumbent: ");
@@ -190,6 +296,27 @@ void remove_vtx_from_left_domain(int *left, bidomain_t *bd, int v){
     bd->left_len--;
 }
 
+// Once v has been left unmatched, its twins in the same domain can be left
+// unmatched too: any mapping using one of them is mirrored by a mapping using v.
+void remove_twins_from_left_domain(int *left, bidomain_t *bd, int v, unsigned int *twin){
+    for (int i = bd->left_len - 1; i >= 0; i--) {
+        if (twin[left[bd->l + i]] == twin[v]) {
+            swap(&left[bd->l + i], &left[bd->l + bd->left_len-1]);
+            bd->left_len--;
+        }
+    }
+}
+
+// True if a twin of w with a smaller index is still in the right domain:
+// w's are tried in increasing order, so that twin already covered this branch.
+bool twin_already_tried(int *right, int start_idx, int len, int w, unsigned int *twin){
+    if (twin[w] == w) return false;
+    for (int i=0; i<len; i++)
+        if (right[start_idx + i] < w && twin[right[start_idx + i]] == twin[w])
+            return true;
+    return false;
+}
+
 int index_of_next_smallest(int *arr, int start_idx, int len, int w){
     int idx = -1;
     int smallest = INT_MAX;
@@ -236,6 +363,30 @@ int partition(int *all_vv, int start, int len, unsigned char *adjrow) {
     return i;
 }
 
+// Splits the vertices adjacent to v and w, at left[l] and right[r], by the
+// label of the edge and, in directed graphs, its direction: both sides are
+// sorted by adjacency value, and every value found on both sides makes a
+// bidomain.
+void add_domains_by_edge_label(bidomain_list_t *new_d, int *left, int *right, int l, int r, int left_len, int right_len, unsigned char *adjrow0, unsigned char *adjrow1) {
+    int *vv0 = left + l, *vv1 = right + r;
+    INSERTION_SORT(int, vv0, left_len, adjrow0[vv0[j-1]] > adjrow0[vv0[j]])
+    INSERTION_SORT(int, vv1, right_len, adjrow1[vv1[j-1]] > adjrow1[vv1[j]])
+    int i = 0, j = 0;
+    while (i < left_len && j < right_len) {
+        unsigned char label0 = adjrow0[vv0[i]], label1 = adjrow1[vv1[j]];
+        if (label0 < label1) {
+            i++;
+        } else if (label0 > label1) {
+            j++;
+        } else {
+            int start_i = i, start_j = j;
+            while (i < left_len && adjrow0[vv0[i]] == label0) i++;
+            while (j < right_len && adjrow1[vv1[j]] == label0) j++;
+            add_bidomain(new_d, l+start_i, r+start_j, i-start_i, j-start_j, true);
+        }
+    }
+}
+
 bidomain_list_t *filter_domains(bidomain_list_t *domains, int* left, int* right, graph_t *g0, graph_t *g1, int v, int w){
     bidomain_list_t *new_d = malloc(sizeof *new_d);
     new_d->len = 0;
@@ -249,12 +400,57 @@ bidomain_list_t *filter_domains(bidomain_list_t *domains, int* left, int* right,
         int right_len_noedge = old_bd->right_len - right_len;
         if (left_len_noedge && right_len_noedge)
             add_bidomain(new_d, old_bd->l+left_len, old_bd->r+right_len, left_len_noedge, right_len_noedge, old_bd->is_adjacent);
-        if (left_len && right_len)
-            add_bidomain(new_d, old_bd->l, old_bd->r, left_len, right_len, true);
+        if (left_len && right_len) {
+            if (arguments.labelled || arguments.directed)
+                add_domains_by_edge_label(new_d, left, right, old_bd->l, old_bd->r, left_len, right_len, g0->adjmat[v], g1->adjmat[w]);
+            else
+                add_bidomain(new_d, old_bd->l, old_bd->r, left_len, right_len, true);
+        }
     }
     return new_d;
 }
 
+int cmp_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int cmp_pair(const void *a, const void *b) {
+    return ((const pair_t*)a)->v - ((const pair_t*)b)->v;
+}
+
+// Canonical encoding of the live bidomains, used as nogood cache key: each
+// domain becomes its sorted left and right slices, and domains are listed by
+// increasing smallest left vertex. Returns the length of the key in bytes.
+unsigned int encode_domains(bidomain_list_t *domains, int *left, int *right, int current_len, int *key){
+    bool connected = arguments.connected && current_len > 0;
+    int k = 0;
+    int min_v = INT_MAX;
+    for (int i = 0; i < domains->len; i++) {
+        bidomain_t *bd = &domains->vals[i];
+        for (int j = 0; j < bd->left_len; j++) {
+            domain_of[left[bd->l + j]] = i;
+            min_v = MIN(min_v, left[bd->l + j]);
+        }
+    }
+    key[k++] = 2 * domains->len + connected;
+    for (int v = min_v, emitted = 0; emitted < domains->len; v++) {
+        if (domain_of[v] == -1) continue;
+        bidomain_t *bd = &domains->vals[domain_of[v]];
+        key[k++] = 2 * bd->left_len + (connected && bd->is_adjacent);
+        key[k++] = bd->right_len;
+        for (int j = 0; j < bd->left_len; j++) {
+            key[k++] = left[bd->l + j];
+            domain_of[left[bd->l + j]] = -1;
+        }
+        qsort(&key[k - bd->left_len], bd->left_len, sizeof *key, cmp_int);
+        memcpy(&key[k], &right[bd->r], bd->right_len * sizeof *key);
+        qsort(&key[k], bd->right_len, sizeof *key, cmp_int);
+        k += bd->right_len;
+        emitted++;
+    }
+    return k * sizeof *key;
+}
+
 bool check_sol(graph_t *g0, graph_t *g1 , mapping_t *solution) {
     bool *used_left = calloc(g0->n, sizeof *used_left);
     bool *used_right = calloc(g1->n, sizeof *used_right);
@@ -297,20 +493,86 @@ double compute_elapsed_sec(struct timespec strt){
 	return time_elapsed;
 }
 
+// SEARCH PROGRESS /////////////////////////////////////////////////////////////////////////////////////////////////////
+// Weighted backtrack estimator: a leaf of solve() at the end of a path with
+// branching factors b_0 ... b_d-1 would be reached by a random probe with
+// probability p = 1/(b_0 ... b_d-1), and that probe would estimate the tree
+// size as T = 1 + b_0 + b_0 b_1 + ... The sums of p and p*T over the leaves
+// visited so far give the explored fraction and, divided, the tree size;
+// both are exact once the search is over.
+
+ULL solve_nodes = 0;
+int search_depth = 0;
+double *branch_total = NULL;                // children of the node at each depth of the current path, NULL unless progress is reported
+double *path_weight, *path_sum;             // b_0 ... b_d-1 and the partial T at each depth
+double leaf_mass = 0, leaf_estimate = 0;
+double next_report = 1;
+
+void progress_enter(){
+    int d = search_depth;
+    path_weight[d] = d == 0 ? 1 : path_weight[d-1] * branch_total[d-1];
+    path_sum[d] = d == 0 ? 1 : path_sum[d-1] + path_weight[d];
+}
+
+void progress_leaf(){
+    leaf_mass += 1 / path_weight[search_depth];
+    leaf_estimate += path_sum[search_depth] / path_weight[search_depth];
+}
+
+void report_progress(){
+    double elapsed = compute_elapsed_sec(start);
+    if (elapsed < next_report || leaf_mass == 0) return;
+    next_report = elapsed + 1;
+    double nodes = leaf_estimate / leaf_mass;
+    printf("progress %.4f%%, %llu nodes, estimated %.3e nodes, %.1f s left\n",
+            100 * leaf_mass, solve_nodes, nodes, nodes > solve_nodes ? elapsed * (nodes - solve_nodes) / solve_nodes : 0);
+}
+
 void solve(graph_t *g0, graph_t *g1, mapping_t *my_incumbent, mapping_t *current, bidomain_list_t *domains, int*left, int*right){
 	if (arguments.timeout && compute_elapsed_sec(start) > arguments.timeout) {
         arguments.timeout = -1;
    	}
-    if (arguments.timeout == -1) return;
+    if (arguments.timeout == -1 || threshold_reached(my_incumbent)) return;
+    solve_nodes++;
+    if (branch_total != NULL) {
+        progress_enter();
+        if ((solve_nodes & 0xFFF) == 0) report_progress();
+    }
     
     if (my_incumbent->len < current->len) set_incumbent(current, my_incumbent);
-    if (current->len + calc_bound(domains) <= my_incumbent->len) return;
+    if (current->len + calc_bound(domains) <= to_beat(my_incumbent)) {
+        if (branch_total != NULL) progress_leaf();
+        return;
+    }
+
+    int *key = NULL;
+    unsigned int key_len = 0, bound;
+    if (nogood != NULL) {
+        key = malloc(nogood->key_size);
+        key_len = encode_domains(domains, left, right, current->len, key);
+        if (nogood_lookup(nogood, key, key_len, &bound) && current->len + bound <= to_beat(my_incumbent)) {
+            if (branch_total != NULL) progress_leaf();
+            free(key);
+            return;
+        }
+    }
+
     int bd_idx = select_bidomain(domains, left, current->len, arguments.connected);
-    if(bd_idx == -1) return;
+    if(bd_idx == -1) {
+        if (branch_total != NULL) progress_leaf();
+        free(key);
+        return;
+    }
     bidomain_t *bd = &domains->vals[bd_idx];
     bd->right_len--;
     int v = find_min_value(left, bd->l, bd->left_len);
     remove_vtx_from_left_domain(left, &domains->vals[bd_idx], v);
+    if (branch_total != NULL) {
+        // one w per twin class and the null branch, as in the loop below
+        branch_total[search_depth] = 1;
+        for (int i = 0; i < bd->right_len + 1; i++)
+            branch_total[search_depth] += !twin_already_tried(right, bd->r, bd->right_len + 1, right[bd->r + i], g1->twin);
+    }
     int w = -1;
     for(int i = 0; i < bd->right_len +1; i++){
         /* try to match vertex v */
@@ -318,18 +580,584 @@ void solve(graph_t *g0, graph_t *g1, mapping_t *my_incumbent, mapping_t *current
         w = right[bd->r + idx];
         right[bd->r + idx] = right[bd->r + bd->right_len];
         right[bd->r + bd->right_len] = w;
+        if (twin_already_tried(right, bd->r, bd->right_len, w, g1->twin)) continue;
 
         bidomain_list_t *new_domains = filter_domains(domains, left, right, g0, g1, v, w);
         current->vals[current->len++] = (pair_t){.v=v, .w=w};
+        search_depth++;
         solve(g0,g1, my_incumbent, current, new_domains, left, right);
+        search_depth--;
         free_domains(new_domains);
         current->len--;
     }
     bd->right_len++;
+    remove_twins_from_left_domain(left, bd, v, g0->twin);
     if (bd->left_len == 0) remove_bidomain(domains, bd_idx);
+    search_depth++;
     solve(g0, g1, my_incumbent, current, domains, left, right);
+    search_depth--;
+
+    /* the whole subtree has been explored: no extension beats the incumbent */
+    if (key != NULL) {
+        if (arguments.timeout != -1 && !threshold_reached(my_incumbent))
+            nogood_store(nogood, key, key_len, to_beat(my_incumbent) - current->len);
+        free(key);
+    }
 }
 
+// CONNECTED MCS ///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Once the first pair is fixed, a connected mapping can only grow through the
+// vertices reachable from the mapped ones without leaving the live domains:
+// the others are dropped from the bound even if calc_bound counts them.
+
+// Sets reach[x] to 2 for the vertices of the left (right) slices reachable in g
+// from the adjacent domains, to 1 for the other vertices of the slices. Only
+// the vertices not reached yet are scanned, so dense graphs stop early.
+void mark_reachable(bidomain_list_t *domains, int *vv, bool right_side, graph_t *g, unsigned char *reach){
+    int head = 0, tail = 0, pending_len = 0;
+    for (int i = 0; i < domains->len; i++) {
+        bidomain_t *bd = &domains->vals[i];
+        int start_idx = right_side ? bd->r : bd->l;
+        int len = right_side ? bd->right_len : bd->left_len;
+        for (int j = 0; j < len; j++) {
+            reach[vv[start_idx + j]] = bd->is_adjacent ? 2 : 1;
+            if (bd->is_adjacent) reach_queue[tail++] = vv[start_idx + j];
+            else reach_pending[pending_len++] = vv[start_idx + j];
+        }
+    }
+    while (head < tail && pending_len > 0) {
+        int u = reach_queue[head++];
+        for (int j = pending_len - 1; j >= 0; j--) {
+            int x = reach_pending[j];
+            if (g->adjmat[u][x]) {
+                reach[x] = 2;
+                reach_queue[tail++] = x;
+                reach_pending[j] = reach_pending[--pending_len];
+            }
+        }
+    }
+}
+
+// Counts the reachable vertices of a slice and clears their marks
+int count_reachable(int *vv, int start_idx, int len, unsigned char *reach){
+    int count = 0;
+    for (int j = 0; j < len; j++) {
+        count += reach[vv[start_idx + j]] == 2;
+        reach[vv[start_idx + j]] = 0;
+    }
+    return count;
+}
+
+int calc_connected_bound(bidomain_list_t *domains, int *left, int *right, graph_t *g0, graph_t *g1){
+    bool all_adjacent = true;
+    for (int i = 0; i < domains->len && all_adjacent; i++)
+        all_adjacent = domains->vals[i].is_adjacent;
+    if (all_adjacent) return calc_bound(domains);   // every vertex is reachable
+
+    mark_reachable(domains, left, false, g0, reach0);
+    mark_reachable(domains, right, true, g1, reach1);
+    int bound = 0;
+    for (int i = 0; i < domains->len; i++) {
+        bidomain_t *bd = &domains->vals[i];
+        int left_len = count_reachable(left, bd->l, bd->left_len, reach0);
+        int right_len = count_reachable(right, bd->r, bd->right_len, reach1);
+        bound += MIN(left_len, right_len);
+    }
+    return bound;
+}
+
+// Same branching as solve(), only on adjacent domains and with the connected bound
+void solve_connected(graph_t *g0, graph_t *g1, mapping_t *my_incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right){
+    if (arguments.timeout && compute_elapsed_sec(start) > arguments.timeout) {
+        arguments.timeout = -1;
+    }
+    if (arguments.timeout == -1 || threshold_reached(my_incumbent)) return;
+
+    if (my_incumbent->len < current->len) set_incumbent(current, my_incumbent);
+    if (current->len + calc_bound(domains) <= to_beat(my_incumbent)) return;
+    if (current->len > 0 && current->len + calc_connected_bound(domains, left, right, g0, g1) <= to_beat(my_incumbent)) return;
+
+    int bd_idx = select_bidomain(domains, left, current->len, true);
+    if (bd_idx == -1) return;
+    bidomain_t *bd = &domains->vals[bd_idx];
+    bd->right_len--;
+    int v = find_min_value(left, bd->l, bd->left_len);
+    remove_vtx_from_left_domain(left, &domains->vals[bd_idx], v);
+    int w = -1;
+    for (int i = 0; i < bd->right_len + 1; i++) {
+        int idx = index_of_next_smallest(right, bd->r, bd->right_len + 1, w);
+        w = right[bd->r + idx];
+        right[bd->r + idx] = right[bd->r + bd->right_len];
+        right[bd->r + bd->right_len] = w;
+        if (twin_already_tried(right, bd->r, bd->right_len, w, g1->twin)) continue;
+
+        bidomain_list_t *new_domains = filter_domains(domains, left, right, g0, g1, v, w);
+        current->vals[current->len++] = (pair_t){.v=v, .w=w};
+        solve_connected(g0, g1, my_incumbent, current, new_domains, left, right);
+        free_domains(new_domains);
+        current->len--;
+    }
+    bd->right_len++;
+    remove_twins_from_left_domain(left, bd, v, g0->twin);
+    if (bd->left_len == 0) remove_bidomain(domains, bd_idx);
+    solve_connected(g0, g1, my_incumbent, current, domains, left, right);
+}
+
+// Decomposition on the first pair: start vertex v is matched with every w and
+// then dropped, so every connected mapping is found under its first vertex and
+// later starts only search what is left of g0.
+void solve_connected_by_start(graph_t *g0, graph_t *g1, mapping_t *incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right){
+    while (arguments.timeout != -1 && !threshold_reached(incumbent)) {
+        if (current->len + calc_bound(domains) <= to_beat(incumbent)) break;
+        int bd_idx = select_bidomain(domains, left, current->len, false);
+        if (bd_idx == -1) break;
+        bidomain_t *bd = &domains->vals[bd_idx];
+        bd->right_len--;
+        int v = find_min_value(left, bd->l, bd->left_len);
+        remove_vtx_from_left_domain(left, bd, v);
+        int w = -1;
+        for (int i = 0; i < bd->right_len + 1; i++) {
+            int idx = index_of_next_smallest(right, bd->r, bd->right_len + 1, w);
+            w = right[bd->r + idx];
+            right[bd->r + idx] = right[bd->r + bd->right_len];
+            right[bd->r + bd->right_len] = w;
+            if (twin_already_tried(right, bd->r, bd->right_len, w, g1->twin)) continue;
+
+            bidomain_list_t *new_domains = filter_domains(domains, left, right, g0, g1, v, w);
+            current->vals[current->len++] = (pair_t){.v=v, .w=w};
+            solve_connected(g0, g1, incumbent, current, new_domains, left, right);
+            free_domains(new_domains);
+            current->len--;
+        }
+        if (arguments.verbose) printf("start vertex %d done, incumbent %d\n", v, incumbent->len);
+        bd->right_len++;
+        remove_twins_from_left_domain(left, bd, v, g0->twin);
+        if (bd->left_len == 0) remove_bidomain(domains, bd_idx);
+    }
+}
+
+mapping_t* copy_solution(mapping_t *src){
+    mapping_t *dst = malloc(sizeof *dst);
+    dst->len = src->len;
+    dst->size = src->size;
+    dst->vals = malloc(dst->size * sizeof *dst->vals);
+    memcpy(dst->vals, src->vals, dst->size * sizeof *dst->vals);
+    return dst;
+}
+
+bidomain_list_t* copy_domains(bidomain_list_t *src){
+    bidomain_list_t *dst = malloc(sizeof *dst);
+    dst->len = src->len;
+    dst->size = src->size;
+    dst->vals = malloc(dst->size * sizeof *dst->vals);
+    memcpy(dst->vals, src->vals, dst->size * sizeof *dst->vals);
+    return dst;
+}
+
+int *copy_array(int *src, int size){
+    int *dst = malloc(size * sizeof *dst);
+    memcpy(dst, src, size * sizeof *dst);
+    return dst;
+}
+
+// TREE SIZE ESTIMATION ////////////////////////////////////////////////////////////////////////////////////////////////
+// Knuth's estimator: a probe walks down the tree of solve() choosing a random
+// child at every node, and each node on its path stands for the product of the
+// branching factors above it. The average over the probes is an unbiased
+// estimate of the number of nodes for a fixed incumbent; since the size of
+// the tree depends heavily on it, the probes start from a greedy dive and
+// keep the best mapping they meet, as solve() would.
+
+double knuth_probe(graph_t *g0, graph_t *g1, mapping_t *incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right, unsigned int *seed, ULL *probe_nodes){
+    mapping_t *cur = copy_solution(current);
+    bidomain_list_t *doms = copy_domains(domains);
+    int *l = copy_array(left, g0->n);
+    int *r = copy_array(right, g1->n);
+    int *candidates = malloc((g1->n + 1) * sizeof *candidates);
+    double estimate = 0, weight = 1;
+    while (true) {
+        estimate += weight;
+        (*probe_nodes)++;
+        if (incumbent->len < cur->len) set_incumbent(cur, incumbent);
+        if (cur->len + calc_bound(doms) <= to_beat(incumbent)) break;
+        int bd_idx = select_bidomain(doms, l, cur->len, arguments.connected);
+        if (bd_idx == -1) break;
+        bidomain_t *bd = &doms->vals[bd_idx];
+        int v = find_min_value(l, bd->l, bd->left_len);
+        remove_vtx_from_left_domain(l, bd, v);
+
+        // the children of solve(): one w per twin class, then the null branch
+        int n_candidates = 0;
+        for (int i = 0; i < bd->right_len; i++)
+            if (!twin_already_tried(r, bd->r, bd->right_len, r[bd->r + i], g1->twin))
+                candidates[n_candidates++] = i;
+        int child = rand_r(seed) % (n_candidates + 1);
+        weight *= n_candidates + 1;
+
+        if (child < n_candidates) {
+            int idx = candidates[child];
+            int w = r[bd->r + idx];
+            r[bd->r + idx] = r[bd->r + bd->right_len - 1];
+            r[bd->r + bd->right_len - 1] = w;
+            bd->right_len--;
+            bidomain_list_t *new_domains = filter_domains(doms, l, r, g0, g1, v, w);
+            free_domains(doms);
+            doms = new_domains;
+            cur->vals[cur->len++] = (pair_t){.v=v, .w=w};
+        } else {
+            remove_twins_from_left_domain(l, bd, v, g0->twin);
+            if (bd->left_len == 0) remove_bidomain(doms, bd_idx);
+        }
+    }
+    free(candidates);
+    free_solution(cur);
+    free_domains(doms);
+    free(l);
+    free(r);
+    return estimate;
+}
+
+// Returns the estimated number of nodes, and in *seconds the time to explore
+// them at the speed of the probes.
+double estimate_tree_size(graph_t *g0, graph_t *g1, mapping_t *incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right, int probes, double *seconds){
+    struct timespec probes_start;
+    clock_gettime(CLOCK_MONOTONIC, &probes_start);
+    unsigned int seed = 1;
+    ULL probe_nodes = 0;
+    double sum = 0;
+    for (int p = 0; p < probes; p++)
+        sum += knuth_probe(g0, g1, incumbent, current, domains, left, right, &seed, &probe_nodes);
+    double nodes = sum / probes;
+    *seconds = nodes * compute_elapsed_sec(probes_start) / probe_nodes;
+    return nodes;
+}
+
+// BEST-FIRST SEARCH ///////////////////////////////////////////////////////////////////////////////////////////////////
+// Open subproblems are kept in a max-heap ordered by their upper bound
+// cur_len + calc_bound, ties broken in favour of the deepest one. When the
+// frontier is full the new subproblems are solved depth-first with solve().
+
+typedef struct subproblem_s {
+    unsigned int bound;
+    mapping_t *current;
+    bidomain_list_t *domains;
+    int *left, *right;
+}subproblem_t;
+
+typedef struct frontier_s {
+    subproblem_t **vals;
+    unsigned len;
+    unsigned size;
+}frontier_t;
+
+int upper_bound = -1;   // proven bound on the optimum, -1 until best-first search has run
+
+bool higher_priority(subproblem_t *a, subproblem_t *b){
+    if (a->bound != b->bound) return a->bound > b->bound;
+    return a->current->len > b->current->len;
+}
+
+void frontier_push(frontier_t *frontier, subproblem_t *sp){
+    int i = frontier->len++;
+    frontier->vals[i] = sp;
+    while (i > 0 && higher_priority(frontier->vals[i], frontier->vals[(i-1)/2])) {
+        subproblem_t *tmp = frontier->vals[i];
+        frontier->vals[i] = frontier->vals[(i-1)/2];
+        frontier->vals[(i-1)/2] = tmp;
+        i = (i-1)/2;
+    }
+}
+
+subproblem_t *frontier_pop(frontier_t *frontier){
+    subproblem_t *top = frontier->vals[0];
+    frontier->vals[0] = frontier->vals[--frontier->len];
+    for (int i = 0; ; ) {
+        int best = i;
+        if (2*i+1 < frontier->len && higher_priority(frontier->vals[2*i+1], frontier->vals[best])) best = 2*i+1;
+        if (2*i+2 < frontier->len && higher_priority(frontier->vals[2*i+2], frontier->vals[best])) best = 2*i+2;
+        if (best == i) break;
+        subproblem_t *tmp = frontier->vals[i];
+        frontier->vals[i] = frontier->vals[best];
+        frontier->vals[best] = tmp;
+        i = best;
+    }
+    return top;
+}
+
+void free_subproblem(subproblem_t *sp){
+    free_solution(sp->current);
+    free_domains(sp->domains);
+    free(sp->left);
+    free(sp->right);
+    free(sp);
+}
+
+// Takes ownership of the subproblem: it is either queued or solved depth-first
+void open_subproblem(graph_t *g0, graph_t *g1, frontier_t *frontier, mapping_t *incumbent, subproblem_t *sp){
+    if (incumbent->len < sp->current->len) set_incumbent(sp->current, incumbent);
+    sp->bound = sp->current->len + calc_bound(sp->domains);
+    if (sp->bound <= to_beat(incumbent)) {
+        free_subproblem(sp);
+    } else if (frontier->len < frontier->size) {
+        frontier_push(frontier, sp);
+    } else {
+        solve(g0, g1, incumbent, sp->current, sp->domains, sp->left, sp->right);
+        free_subproblem(sp);
+    }
+}
+
+void best_first(graph_t *g0, graph_t *g1, mapping_t *incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right){
+    size_t node_bytes = sizeof(subproblem_t) + current->size * (sizeof(pair_t) + sizeof(bidomain_t)) + (g0->n + g1->n) * sizeof(int);
+    frontier_t frontier;
+    frontier.len = 0;
+    frontier.size = MAX(((size_t)arguments.best_first_mb << 20) / node_bytes, 1);
+    frontier.vals = malloc(frontier.size * sizeof *frontier.vals);
+
+    subproblem_t *root = malloc(sizeof *root);
+    root->current = copy_solution(current);
+    root->domains = copy_domains(domains);
+    root->left = copy_array(left, g0->n);
+    root->right = copy_array(right, g1->n);
+    open_subproblem(g0, g1, &frontier, incumbent, root);
+
+    while (frontier.len > 0) {
+        if (arguments.timeout && compute_elapsed_sec(start) > arguments.timeout) {
+            arguments.timeout = -1;
+            break;
+        }
+        if (threshold_reached(incumbent))
+            break;
+        subproblem_t *sp = frontier_pop(&frontier);
+        // sp has the highest bound of all open subproblems
+        if (sp->bound <= to_beat(incumbent)) {
+            free_subproblem(sp);
+            break;
+        }
+        if (upper_bound != sp->bound) {
+            upper_bound = sp->bound;
+            if (!arguments.quiet) printf("upper bound %d, incumbent %d\n", upper_bound, incumbent->len);
+        }
+
+        int bd_idx = select_bidomain(sp->domains, sp->left, sp->current->len, arguments.connected);
+        if (bd_idx == -1) {
+            free_subproblem(sp);
+            continue;
+        }
+        bidomain_t *bd = &sp->domains->vals[bd_idx];
+        bd->right_len--;
+        int v = find_min_value(sp->left, bd->l, bd->left_len);
+        remove_vtx_from_left_domain(sp->left, bd, v);
+        int w = -1;
+        for (int i = 0; i < bd->right_len + 1; i++) {
+            int idx = index_of_next_smallest(sp->right, bd->r, bd->right_len + 1, w);
+            w = sp->right[bd->r + idx];
+            sp->right[bd->r + idx] = sp->right[bd->r + bd->right_len];
+            sp->right[bd->r + bd->right_len] = w;
+            if (twin_already_tried(sp->right, bd->r, bd->right_len, w, g1->twin)) continue;
+
+            subproblem_t *child = malloc(sizeof *child);
+            child->domains = filter_domains(sp->domains, sp->left, sp->right, g0, g1, v, w);
+            child->current = copy_solution(sp->current);
+            child->current->vals[child->current->len++] = (pair_t){.v=v, .w=w};
+            child->left = copy_array(sp->left, g0->n);
+            child->right = copy_array(sp->right, g1->n);
+            open_subproblem(g0, g1, &frontier, incumbent, child);
+        }
+        /* the subproblem itself becomes the branch leaving v unmatched */
+        bd->right_len++;
+        remove_twins_from_left_domain(sp->left, bd, v, g0->twin);
+        if (bd->left_len == 0) remove_bidomain(sp->domains, bd_idx);
+        open_subproblem(g0, g1, &frontier, incumbent, sp);
+    }
+
+    /* after a timeout or an early exit the last bound popped from the frontier is still valid */
+    if (arguments.timeout != -1 && !threshold_reached(incumbent))
+        upper_bound = to_beat(incumbent);
+    while (frontier.len > 0)
+        free_subproblem(frontier_pop(&frontier));
+    free(frontier.vals);
+}
+
+// ANYTIME HEURISTICS //////////////////////////////////////////////////////////////////////////////////////////////////
+// Both heuristics follow the select_bidomain / smallest-w order of solve() and
+// leave their best mapping in the incumbent, which the exact search starts from.
+
+// Depth-first search where every branch but the first one of a node costs a
+// discrepancy; only paths with at most `discrepancies` of them are explored.
+void lds(graph_t *g0, graph_t *g1, mapping_t *my_incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right, int discrepancies){
+    if (arguments.timeout && compute_elapsed_sec(start) > arguments.timeout) {
+        arguments.timeout = -1;
+    }
+    if (arguments.timeout == -1 || threshold_reached(my_incumbent)) return;
+
+    if (my_incumbent->len < current->len) set_incumbent(current, my_incumbent);
+    if (current->len + calc_bound(domains) <= to_beat(my_incumbent)) return;
+    int bd_idx = select_bidomain(domains, left, current->len, arguments.connected);
+    if(bd_idx == -1) return;
+    bidomain_t *bd = &domains->vals[bd_idx];
+    bd->right_len--;
+    int v = find_min_value(left, bd->l, bd->left_len);
+    remove_vtx_from_left_domain(left, &domains->vals[bd_idx], v);
+    int w = -1, tried = 0;
+    for(int i = 0; i < bd->right_len +1 && (tried == 0 || discrepancies > 0); i++){
+        int idx = index_of_next_smallest(right, bd->r, bd->right_len + 1, w);
+        w = right[bd->r + idx];
+        right[bd->r + idx] = right[bd->r + bd->right_len];
+        right[bd->r + bd->right_len] = w;
+        if (twin_already_tried(right, bd->r, bd->right_len, w, g1->twin)) continue;
+
+        bidomain_list_t *new_domains = filter_domains(domains, left, right, g0, g1, v, w);
+        current->vals[current->len++] = (pair_t){.v=v, .w=w};
+        lds(g0, g1, my_incumbent, current, new_domains, left, right, discrepancies - (tried > 0));
+        free_domains(new_domains);
+        current->len--;
+        tried++;
+    }
+    bd->right_len++;
+    if (tried > 0 && discrepancies == 0) return;
+    remove_twins_from_left_domain(left, bd, v, g0->twin);
+    if (bd->left_len == 0) remove_bidomain(domains, bd_idx);
+    lds(g0, g1, my_incumbent, current, domains, left, right, discrepancies - (tried > 0));
+}
+
+int cmp_subproblem(const void *a, const void *b){
+    subproblem_t *sa = *(subproblem_t**)a;
+    subproblem_t *sb = *(subproblem_t**)b;
+    if (higher_priority(sa, sb)) return -1;
+    if (higher_priority(sb, sa)) return 1;
+    return 0;
+}
+
+// Breadth-first expansion keeping only the `width` most promising subproblems
+// (highest cur_len + calc_bound) after every branching step.
+void beam(graph_t *g0, graph_t *g1, mapping_t *incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right, int width){
+    unsigned int children_size = width * (g1->n + 1);
+    subproblem_t **level = malloc(width * sizeof *level);
+    subproblem_t **children = malloc(children_size * sizeof *children);
+    unsigned int level_len = 1;
+
+    level[0] = malloc(sizeof *level[0]);
+    level[0]->current = copy_solution(current);
+    level[0]->domains = copy_domains(domains);
+    level[0]->left = copy_array(left, g0->n);
+    level[0]->right = copy_array(right, g1->n);
+
+    while (level_len > 0 && !threshold_reached(incumbent)) {
+        if (arguments.timeout && compute_elapsed_sec(start) > arguments.timeout) {
+            arguments.timeout = -1;
+            break;
+        }
+        unsigned int children_len = 0;
+        for (unsigned int s = 0; s < level_len; s++) {
+            subproblem_t *sp = level[s];
+            int bd_idx = select_bidomain(sp->domains, sp->left, sp->current->len, arguments.connected);
+            if (bd_idx == -1) {
+                free_subproblem(sp);
+                continue;
+            }
+            bidomain_t *bd = &sp->domains->vals[bd_idx];
+            bd->right_len--;
+            int v = find_min_value(sp->left, bd->l, bd->left_len);
+            remove_vtx_from_left_domain(sp->left, bd, v);
+            int w = -1;
+            for (int i = 0; i < bd->right_len + 1; i++) {
+                int idx = index_of_next_smallest(sp->right, bd->r, bd->right_len + 1, w);
+                w = sp->right[bd->r + idx];
+                sp->right[bd->r + idx] = sp->right[bd->r + bd->right_len];
+                sp->right[bd->r + bd->right_len] = w;
+                if (twin_already_tried(sp->right, bd->r, bd->right_len, w, g1->twin)) continue;
+
+                subproblem_t *child = malloc(sizeof *child);
+                child->domains = filter_domains(sp->domains, sp->left, sp->right, g0, g1, v, w);
+                child->current = copy_solution(sp->current);
+                child->current->vals[child->current->len++] = (pair_t){.v=v, .w=w};
+                child->left = copy_array(sp->left, g0->n);
+                child->right = copy_array(sp->right, g1->n);
+                children[children_len++] = child;
+            }
+            bd->right_len++;
+            remove_twins_from_left_domain(sp->left, bd, v, g0->twin);
+            if (bd->left_len == 0) remove_bidomain(sp->domains, bd_idx);
+            children[children_len++] = sp;
+        }
+
+        level_len = 0;
+        for (unsigned int c = 0; c < children_len; c++) {
+            subproblem_t *child = children[c];
+            if (incumbent->len < child->current->len) set_incumbent(child->current, incumbent);
+            child->bound = child->current->len + calc_bound(child->domains);
+            if (child->bound > to_beat(incumbent)) children[level_len++] = child;
+            else free_subproblem(child);
+        }
+        qsort(children, level_len, sizeof *children, cmp_subproblem);
+        for (unsigned int c = width; c < level_len; c++)
+            free_subproblem(children[c]);
+        level_len = MIN(level_len, width);
+        memcpy(level, children, level_len * sizeof *level);
+    }
+
+    for (unsigned int s = 0; s < level_len; s++)
+        free_subproblem(level[s]);
+    free(level);
+    free(children);
+}
+
+// lds() and beam() consume the domains they are given, so each run works on copies
+void run_heuristic(graph_t *g0, graph_t *g1, mapping_t *incumbent, mapping_t *current, bidomain_list_t *domains, int *left, int *right, int width, int discrepancies){
+    bidomain_list_t *h_domains = copy_domains(domains);
+    int *h_left = copy_array(left, g0->n);
+    int *h_right = copy_array(right, g1->n);
+    if (width > 0)
+        beam(g0, g1, incumbent, current, h_domains, h_left, h_right, width);
+    else
+        lds(g0, g1, incumbent, current, h_domains, h_left, h_right, discrepancies);
+    if (!arguments.quiet)
+        printf("heuristic incumbent %d after %.6f s\n", incumbent->len, compute_elapsed_sec(start));
+    free_domains(h_domains);
+    free(h_left);
+    free(h_right);
+}
+
+// CLIQUE ENGINE ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool clique_should_stop(unsigned int incumbent_size){
+    if (arguments.timeout && compute_elapsed_sec(start) > arguments.timeout) {
+        arguments.timeout = -1;
+    }
+    return arguments.timeout == -1 || (threshold && incumbent_size >= threshold);
+}
+
+mapping_t *mcs_clique(graph_t *g0, graph_t *g1){
+    mapping_t *incumbent = calloc(1, sizeof *incumbent);
+    incumbent->size = MIN(g0->n, g1->n);
+    incumbent->vals = calloc(incumbent->size, sizeof *incumbent->vals);
+    int *sol = malloc(2 * incumbent->size * sizeof *sol + 1);
+    incumbent->len = clique_mcs(g0, g1, threshold ? threshold - 1 : 0, clique_should_stop, arguments.verbose, sol);
+    for (int i = 0; i < incumbent->len; i++)
+        incumbent->vals[i] = (pair_t){.v=sol[2*i], .w=sol[2*i+1]};
+    free(sol);
+    return incumbent;
+}
+
+// SPARSE ENGINE ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The options that only the dense engine has
+bool dense_only_options(){
+    return arguments.clique || arguments.nogood_mb > 0 || arguments.best_first_mb > 0 || arguments.lds >= 0 ||
+           arguments.beam > 0 || arguments.estimate > 0 || arguments.estimate_only;
+}
+
+mapping_t *mcs_sparse(sparse_graph_t *g0, sparse_graph_t *g1){
+    mapping_t *incumbent = calloc(1, sizeof *incumbent);
+    incumbent->size = MIN(g0->n, g1->n);
+    incumbent->vals = calloc(incumbent->size, sizeof *incumbent->vals);
+    int *sol = malloc(2 * incumbent->size * sizeof *sol + 1);
+    incumbent->len = sparse_mcs(g0, g1, threshold ? threshold - 1 : 0, arguments.connected, clique_should_stop, arguments.verbose, sol);
+    for (int i = 0; i < incumbent->len; i++)
+        incumbent->vals[i] = (pair_t){.v=sol[2*i], .w=sol[2*i+1]};
+    free(sol);
+    return incumbent;
+}
 
 mapping_t *mcs(graph_t *g0, graph_t *g1){
 
@@ -349,25 +1177,87 @@ mapping_t *mcs(graph_t *g0, graph_t *g1){
 
     int *left = malloc(g0->n* sizeof *left );  // the buffer of vertex indices for the left partitions
     int *right = malloc(g1->n* sizeof *right );  // the buffer of vertex indices for the right partitions
-    int l = 0, r = 0;  // next free index in left and right
 
-    for (int label=0; label<=1; label++) {
-        int start_l = l;
-        int start_r = r;
-        for (int i=0; i<g0->n; i++)
-            if (g0->label[i]==label)
-                left[l++] = i;
-        for (int i=0; i<g1->n; i++)
-            if (g1->label[i]==label)
-                right[r++] = i;
+    // One bidomain per vertex label found in both graphs, the self-loop
+    // being part of the label
+    for (int i=0; i<g0->n; i++) left[i] = i;
+    for (int i=0; i<g1->n; i++) right[i] = i;
+    INSERTION_SORT(int, left, g0->n, g0->label[left[j-1]] > g0->label[left[j]])
+    INSERTION_SORT(int, right, g1->n, g1->label[right[j-1]] > g1->label[right[j]])
+    for (int l = 0, r = 0; l < g0->n && r < g1->n; ) {
+        unsigned int label = g0->label[left[l]];
+        if (label < g1->label[right[r]]) {
+            l++;
+        } else if (label > g1->label[right[r]]) {
+            r++;
+        } else {
+            int start_l = l, start_r = r;
+            while (l < g0->n && g0->label[left[l]] == label) l++;
+            while (r < g1->n && g1->label[right[r]] == label) r++;
+            add_bidomain(domains, start_l, start_r, l - start_l, r - start_r, false);
+        }
+    }
 
-        int left_len = l - start_l;
-        int right_len = r - start_r;
-        if (left_len && right_len)
-            add_bidomain(domains, start_l, start_r, left_len, right_len, false);
+    if (arguments.nogood_mb > 0) {
+        nogood = nogood_init(arguments.nogood_mb, (1 + 2*size + g0->n + g1->n) * sizeof(int));
+        domain_of = malloc(g0->n * sizeof *domain_of);
+        for (int i=0; i<g0->n; i++) domain_of[i] = -1;
     }
 
-    solve(g0, g1, incumbent, current, domains, left, right);
+    /* the root bound alone may already rule the threshold out, every search below then stops at the root */
+    if (threshold && calc_bound(domains) < threshold && !arguments.quiet)
+        printf("root bound %d below threshold\n", calc_bound(domains));
+
+    if (arguments.beam > 0)
+        run_heuristic(g0, g1, incumbent, current, domains, left, right, arguments.beam, 0);
+    for (int k = 0; k <= arguments.lds && arguments.timeout != -1; k++)
+        run_heuristic(g0, g1, incumbent, current, domains, left, right, 0, k);
+
+    if (arguments.estimate > 0 || arguments.estimate_only) {
+        if (arguments.lds < 0 && arguments.beam == 0)
+            run_heuristic(g0, g1, incumbent, current, domains, left, right, 0, 0);
+        double seconds, nodes = estimate_tree_size(g0, g1, incumbent, current, domains, left, right, arguments.estimate > 0 ? arguments.estimate : 1000, &seconds);
+        printf("Estimated tree size %.3e nodes, estimated time %.3f s\n", nodes, seconds);
+        // progress is tracked along the path of solve() only
+        if (!arguments.estimate_only && arguments.best_first_mb == 0 && !arguments.connected) {
+            branch_total = malloc((g0->n + 2) * sizeof *branch_total);
+            path_weight = malloc((g0->n + 2) * sizeof *path_weight);
+            path_sum = malloc((g0->n + 2) * sizeof *path_sum);
+        }
+    }
+
+    if (arguments.estimate_only) {
+        /* nothing to solve */
+    } else if (arguments.best_first_mb > 0) {
+        best_first(g0, g1, incumbent, current, domains, left, right);
+    } else if (arguments.connected) {
+        reach0 = calloc(g0->n, sizeof *reach0);
+        reach1 = calloc(g1->n, sizeof *reach1);
+        reach_queue = malloc(MAX(g0->n, g1->n) * sizeof *reach_queue);
+        reach_pending = malloc(MAX(g0->n, g1->n) * sizeof *reach_pending);
+        solve_connected_by_start(g0, g1, incumbent, current, domains, left, right);
+        free(reach0);
+        free(reach1);
+        free(reach_queue);
+        free(reach_pending);
+    } else {
+        solve(g0, g1, incumbent, current, domains, left, right);
+    }
+    if (branch_total != NULL) {
+        printf("Search tree %llu nodes\n", solve_nodes);
+        free(branch_total);
+        free(path_weight);
+        free(path_sum);
+        branch_total = NULL;
+    }
+
+    if (nogood != NULL) {
+        if (arguments.verbose)
+            printf("nogood cache: %u slots, %llu stores, %llu hits\n", nogood->n_slots, nogood->stores, nogood->hits);
+        nogood_free(nogood);
+        free(domain_of);
+        nogood = NULL;
+    }
 
     free(left);
     free(right);
@@ -378,49 +1268,138 @@ mapping_t *mcs(graph_t *g0, graph_t *g1){
 }
 
 
+// GRAPH PREPARATION ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The two graphs are read, and then sorted, each by a thread of its own
+typedef struct prepare_s {
+    char *filename;
+    sparse_graph_t *s;
+    graph_t *g;         // the dense graph built from s, which is then freed, unless sparse
+    bool sparse;
+    bool ascending;
+}prepare_t;
+
+void *read_graph(void *arg){
+    prepare_t *p = arg;
+    p->s = calloc(1, sizeof *p->s);
+    readSparseGraph(p->filename, p->s, arguments.lad ? 'L' : 'B', arguments.directed, arguments.labelled);
+    return NULL;
+}
+
+void *sort_graph(void *arg){
+    prepare_t *p = arg;
+    if (p->sparse) {
+        p->s = sort_sparse_vertices_by_degree(p->s, p->ascending);
+    } else {
+        p->g = sort_vertices_by_degree(dense_graph(p->s), p->ascending);
+        free_sparse_graph(p->s);
+        p->s = NULL;
+    }
+    return NULL;
+}
+
+// Runs f on the second graph in a new thread while running it on the first
+void on_both_graphs(void *(*f)(void *), prepare_t *prep){
+    pthread_t thread;
+    bool spawned = pthread_create(&thread, NULL, f, &prep[1]) == 0;
+    f(&prep[0]);
+    if (spawned)
+        pthread_join(thread, NULL);
+    else
+        f(&prep[1]);
+}
+
 int main(int argc, char** argv) {
 	set_default_arguments();
 	argp_parse(&argp, argc, argv, 0, 0, 0);
 	struct timespec finish;
 	double time_elapsed;
 	char format = arguments.lad ? 'L' : 'B';
-	graph_t *g0 = calloc(1, sizeof *g0 );
-	readGraph(arguments.filename1, g0, format);
-	graph_t *g1 = calloc(1, sizeof *g1 );
-	readGraph(arguments.filename2, g1, format);
-	g0 = sort_vertices_by_degree(g0, (graph_edge_count(g1) > g1->n*(g1->n-1)/2));
-	g1 = sort_vertices_by_degree(g1, (graph_edge_count(g0) > g0->n*(g0->n-1)/2));
+	prepare_t prep[2] = { { .filename = arguments.filename1 }, { .filename = arguments.filename2 } };
+	on_both_graphs(read_graph, prep);
+	sparse_graph_t *s0 = prep[0].s, *s1 = prep[1].s;
+	int n0 = s0->n, n1 = s1->n;
+	if (format != 'L')
+		printf("%d vertices\n%d vertices\n", n0, n1);
+	if (arguments.sparse && dense_only_options())
+	    fail("*** Error: the sparse engine does not support --clique, --nogood-cache, --best-first, --lds, --beam or --estimate");
+	bool sparse = arguments.sparse || (!arguments.dense && !dense_only_options() && sparse_pays_off(s0, s1));
+	// vertices are sorted by decreasing degree, or increasing if the other graph is dense
+	for (int k = 0; k < 2; k++) {
+	    prep[k].sparse = sparse;
+	    prep[k].ascending = sparse_edge_count(prep[1-k].s) > (unsigned int)prep[1-k].s->n*(prep[1-k].s->n-1)/2;
+	}
+	on_both_graphs(sort_graph, prep);
+	s0 = prep[0].s;
+	s1 = prep[1].s;
+	graph_t *g0 = prep[0].g, *g1 = prep[1].g;
+	if (arguments.verbose)
+	    printf("%s engine\n", sparse ? "sparse" : "dense");
 
 
 	printf("timeout %d\n", arguments.timeout);
 
 
+	if (arguments.ratio > 0) {
+	    double k = arguments.ratio * MIN(n0, n1);
+	    threshold = (int)k + ((int)k < k);
+	} else {
+	    threshold = arguments.at_least;
+	}
+
 	clock_gettime(CLOCK_MONOTONIC, &start);
 
-	mapping_t *solution = mcs(g0, g1);
+	mapping_t *solution = sparse ? mcs_sparse(s0, s1) : arguments.clique ? mcs_clique(g0, g1) : mcs(g0, g1);
 
     clock_gettime(CLOCK_MONOTONIC, &finish);
+    if (arguments.estimate_only) {
+        free_solution(solution);
+        free_graph(g0);
+        free_graph(g1);
+        return 0;
+    }
 
-    if (!check_sol(g0, g1, solution)){
+    bool valid;
+    if (sparse) {
+        int *sol = malloc(2 * solution->len * sizeof *sol + 1);
+        for (int i = 0; i < solution->len; i++) {
+            sol[2*i] = solution->vals[i].v;
+            sol[2*i+1] = solution->vals[i].w;
+        }
+        valid = sparse_check(s0, s1, sol, solution->len);
+        free(sol);
+    } else {
+        valid = check_sol(g0, g1, solution);
+    }
+    if (!valid){
         fail("*** Error: Invalid solution\n");
 	}
 	if (arguments.timeout == -1){
         printf("TIMEOUT\n");
 	}
+	if (upper_bound >= 0)
+        printf("Upper bound %d\n", upper_bound);
+	if (threshold > 0 && arguments.timeout != -1)
+        printf("Threshold %d %s\n", threshold, threshold_reached(solution) ? "reached" : "not reachable");
 	
 	time_elapsed = (finish.tv_sec - start.tv_sec); // calculating elapsed seconds
 	time_elapsed += (double)(finish.tv_nsec - start.tv_nsec) / 1000000000.0; // adding elapsed nanoseconds
 	
     printf("Solution size %d\n", solution->len);
-    for (int i=0; i<g0->n; i++)
-        for (int j=0; j<solution->len; j++)
-            if (solution->vals[j].v == i)
-                printf("(%d -> %d) ", solution->vals[j].v, solution->vals[j].w);
+    qsort(solution->vals, solution->len, sizeof *solution->vals, cmp_pair);
+    for (int j=0; j<solution->len; j++)
+        printf("(%d -> %d) ", solution->vals[j].v, solution->vals[j].w);
     printf("\n");
 
     printf(">>> %d -  %015.10f\n", solution->len, time_elapsed);
 
-    free_graph(g0);
-    free_graph(g1);
+    free_solution(solution);
+    if (sparse) {
+        free_sparse_graph(s0);
+        free_sparse_graph(s1);
+    } else {
+        free_graph(g0);
+        free_graph(g1);
+    }
     return 0;
 }
@@ -0,0 +1,76 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "nogood.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned long long hash_key(const unsigned char *key, unsigned int len) {
+    unsigned long long h = 14695981039346656037ULL;   // FNV-1a
+    for (unsigned int i = 0; i < len; i++) {
+        h ^= key[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// The number of slots is the largest power of two fitting in the given memory
+nogood_cache_t *nogood_init(unsigned int megabytes, unsigned int key_size) {
+    nogood_cache_t *cache = calloc(1, sizeof *cache);
+    unsigned long long budget = (unsigned long long)megabytes << 20;
+    unsigned long long slot_size = key_size + 2 * sizeof(unsigned int);
+    cache->n_slots = 1;
+    while (2 * cache->n_slots * slot_size <= budget && cache->n_slots < (1u << 30))
+        cache->n_slots *= 2;
+    cache->key_size = key_size;
+    cache->keys = malloc((size_t)cache->n_slots * key_size);
+    cache->key_len = calloc(cache->n_slots, sizeof *cache->key_len);
+    cache->bound = calloc(cache->n_slots, sizeof *cache->bound);
+    if (cache->keys == NULL || cache->key_len == NULL || cache->bound == NULL) {
+        printf("Cannot allocate the nogood cache\n");
+        exit(1);
+    }
+    return cache;
+}
+
+bool nogood_lookup(nogood_cache_t *cache, const void *key, unsigned int len, unsigned int *bound) {
+    unsigned int slot = hash_key(key, len) & (cache->n_slots - 1);
+    if (cache->key_len[slot] != len || memcmp(&cache->keys[(size_t)slot * cache->key_size], key, len) != 0)
+        return false;
+    *bound = cache->bound[slot];
+    cache->hits++;
+    return true;
+}
+
+void nogood_store(nogood_cache_t *cache, const void *key, unsigned int len, unsigned int bound) {
+    if (len == 0 || len > cache->key_size) return;
+    unsigned int slot = hash_key(key, len) & (cache->n_slots - 1);
+    memcpy(&cache->keys[(size_t)slot * cache->key_size], key, len);
+    cache->key_len[slot] = len;
+    cache->bound[slot] = bound;
+    cache->stores++;
+}
+
+void nogood_free(nogood_cache_t *cache) {
+    free(cache->keys);
+    free(cache->key_len);
+    free(cache->bound);
+    free(cache);
+}
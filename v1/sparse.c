@@ -0,0 +1,354 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "sparse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPARSE_MIN_VERTICES 1000    // below this, the adjacency matrices are small anyway
+#define SPARSE_MAX_DENSITY 0.05     // above this, scanning the domains costs about as much as the lists
+
+typedef struct domain_s {
+    int l, r;
+    int left_len, right_len;
+    bool is_adjacent;
+} domain_t;
+
+// The state of the search. left and right hold the vertices of g0 and g1,
+// the domains of each node are disjoint slices of them, and pos0 (pos1) is
+// the index of each vertex in left (right).
+typedef struct search_s {
+    sparse_graph_t *g0, *g1;
+    int *left, *right;
+    int *pos0, *pos1;
+    int *next_twin0;            // the other vertices of the twin class, -1 at the end
+    int *moved0, *moved1;       // neighbours of v (w) moved to the front of each domain
+    unsigned char *value0, *value1;     // value of the edge from v (w) to the moved vertices
+    unsigned long long *keys;   // scratch buffer of sort_by_value
+    int *current, current_len;  // v0 w0 v1 w1 ...
+    int *best, best_len;
+    unsigned int floor;
+    bool connected;
+    bool multiway;              // some edge has a value other than 1, so domains are split by value
+    bool (*stop)(unsigned int);
+    bool verbose;
+    bool stopped;
+}search_t;
+
+static void swap_vertices(int *vv, int *pos, int i, int j) {
+    int x = vv[i], y = vv[j];
+    vv[i] = y;
+    vv[j] = x;
+    pos[y] = i;
+    pos[x] = j;
+}
+
+// Index of the domain whose live slice holds position p, -1 if none: the
+// domains are in increasing order of start, on both sides
+static int find_domain(domain_t *d, int len, int p, bool right_side) {
+    int lo = 0, hi = len;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if ((right_side ? d[mid].r : d[mid].l) <= p) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return -1;
+    domain_t *bd = &d[lo - 1];
+    return right_side ? (p < bd->r + bd->right_len ? lo - 1 : -1) : (p < bd->l + bd->left_len ? lo - 1 : -1);
+}
+
+// Moves the neighbours of v that are in a live slice to the front of it,
+// counting them in moved and keeping the value of their edge
+static void move_neighbours(sparse_graph_t *g, int v, domain_t *d, int len, int *vv, int *pos, int *moved, unsigned char *value, bool right_side) {
+    for (unsigned int k = g->offset[v]; k < g->offset[v + 1]; k++) {
+        int x = g->adj[k];
+        int i = find_domain(d, len, pos[x], right_side);
+        if (i < 0) continue;
+        swap_vertices(vv, pos, (right_side ? d[i].r : d[i].l) + moved[i]++, pos[x]);
+        value[x] = g->value[k];
+    }
+}
+
+static int cmp_key(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void sort_by_value(search_t *s, int *vv, int *pos, int start, int len, unsigned char *value) {
+    for (int i = 0; i < len; i++)
+        s->keys[i] = (unsigned long long) value[vv[start + i]] << 32 | (unsigned int) vv[start + i];
+    qsort(s->keys, len, sizeof *s->keys, cmp_key);
+    for (int i = 0; i < len; i++) {
+        vv[start + i] = (int) (s->keys[i] & 0xffffffffu);
+        pos[vv[start + i]] = start + i;
+    }
+}
+
+// The domains of the child of (v,w), in increasing order of start: for each
+// domain, the vertices adjacent to v and w, split by value, then the others
+static int split_domains(search_t *s, domain_t *d, int len, int v, int w, domain_t *out) {
+    for (int i = 0; i < len; i++)
+        s->moved0[i] = s->moved1[i] = 0;
+    move_neighbours(s->g0, v, d, len, s->left, s->pos0, s->moved0, s->value0, false);
+    move_neighbours(s->g1, w, d, len, s->right, s->pos1, s->moved1, s->value1, true);
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        domain_t *bd = &d[i];
+        int l_len = s->moved0[i], r_len = s->moved1[i];
+        if (l_len && r_len && s->multiway) {
+            sort_by_value(s, s->left, s->pos0, bd->l, l_len, s->value0);
+            sort_by_value(s, s->right, s->pos1, bd->r, r_len, s->value1);
+            for (int a = 0, b = 0; a < l_len && b < r_len; ) {
+                unsigned char value = s->value0[s->left[bd->l + a]];
+                if (value < s->value1[s->right[bd->r + b]]) {
+                    a++;
+                } else if (value > s->value1[s->right[bd->r + b]]) {
+                    b++;
+                } else {
+                    int start_a = a, start_b = b;
+                    while (a < l_len && s->value0[s->left[bd->l + a]] == value) a++;
+                    while (b < r_len && s->value1[s->right[bd->r + b]] == value) b++;
+                    out[n++] = (domain_t) { bd->l + start_a, bd->r + start_b, a - start_a, b - start_b, true };
+                }
+            }
+        } else if (l_len && r_len) {
+            out[n++] = (domain_t) { bd->l, bd->r, l_len, r_len, true };
+        }
+        if (bd->left_len - l_len && bd->right_len - r_len)
+            out[n++] = (domain_t) { bd->l + l_len, bd->r + r_len, bd->left_len - l_len, bd->right_len - r_len, bd->is_adjacent };
+    }
+    return n;
+}
+
+static int calc_bound(domain_t *d, int len) {
+    int bound = 0;
+    for (int i = 0; i < len; i++)
+        bound += d[i].left_len < d[i].right_len ? d[i].left_len : d[i].right_len;
+    return bound;
+}
+
+// The smallest domain, the first one on ties
+static int select_domain(search_t *s, domain_t *d, int len) {
+    int best = -1, min_size = 0;
+    for (int i = 0; i < len; i++) {
+        if (d[i].left_len == 0 || d[i].right_len == 0) continue;
+        if (s->connected && s->current_len > 0 && !d[i].is_adjacent) continue;
+        int size = d[i].left_len > d[i].right_len ? d[i].left_len : d[i].right_len;
+        if (best == -1 || size < min_size) {
+            min_size = size;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void solve(search_t *s, domain_t *d, int len) {
+    if (s->stopped || (s->stopped = s->stop(s->best_len))) return;
+    if (s->current_len > s->best_len) {
+        s->best_len = s->current_len;
+        memcpy(s->best, s->current, 2 * s->best_len * sizeof *s->best);
+        if (s->verbose) printf("sparse incumbent %d\n", s->best_len);
+    }
+    int to_beat = s->best_len > (int) s->floor ? s->best_len : (int) s->floor;
+    if (s->current_len + calc_bound(d, len) <= to_beat) return;
+
+    int bd_idx = select_domain(s, d, len);
+    if (bd_idx == -1) return;
+    domain_t *bd = &d[bd_idx];
+
+    // v is the smallest vertex, the one of highest degree
+    int v = s->left[bd->l];
+    for (int i = 1; i < bd->left_len; i++)
+        if (s->left[bd->l + i] < v) v = s->left[bd->l + i];
+    swap_vertices(s->left, s->pos0, s->pos0[v], bd->l + bd->left_len - 1);
+    bd->left_len--;
+
+    // the w's by twin class, so that only the first of each class is tried
+    int n_w = bd->right_len;
+    int *ws = malloc(n_w * sizeof *ws);
+    for (int i = 0; i < n_w; i++)
+        s->keys[i] = (unsigned long long) s->g1->twin[s->right[bd->r + i]] << 32 | (unsigned int) s->right[bd->r + i];
+    qsort(s->keys, n_w, sizeof *s->keys, cmp_key);
+    for (int i = 0; i < n_w; i++)
+        ws[i] = (int) (s->keys[i] & 0xffffffffu);
+    domain_t *child = malloc((len + s->g0->offset[v + 1] - s->g0->offset[v] + 1) * sizeof *child);
+    bd->right_len--;
+    for (int i = 0; i < n_w && !s->stopped; i++) {
+        int w = ws[i];
+        if (i > 0 && s->g1->twin[w] == s->g1->twin[ws[i - 1]]) continue;
+        // w goes after the slice, out of the way of the split
+        swap_vertices(s->right, s->pos1, s->pos1[w], bd->r + bd->right_len);
+        int child_len = split_domains(s, d, len, v, w, child);
+        s->current[2 * s->current_len] = v;
+        s->current[2 * s->current_len + 1] = w;
+        s->current_len++;
+        solve(s, child, child_len);
+        s->current_len--;
+    }
+    bd->right_len++;
+    free(child);
+    free(ws);
+    if (s->stopped) return;
+
+    // v is left unmatched, and so are its twins in the domain
+    for (int u = s->g0->twin[v]; u != -1; u = s->next_twin0[u])
+        if (s->pos0[u] >= bd->l && s->pos0[u] < bd->l + bd->left_len) {
+            swap_vertices(s->left, s->pos0, s->pos0[u], bd->l + bd->left_len - 1);
+            bd->left_len--;
+        }
+    solve(s, d, len);
+}
+
+typedef struct label_key_s {
+    unsigned int label;
+    int v;
+} label_key_t;
+
+static int cmp_label_key(const void *a, const void *b) {
+    const label_key_t *x = a, *y = b;
+    if (x->label != y->label) return x->label < y->label ? -1 : 1;
+    return x->v - y->v;
+}
+
+static void sort_by_label(sparse_graph_t *g, int *vv, int *pos) {
+    label_key_t *key = malloc(g->n * sizeof *key + 1);
+    for (int v = 0; v < g->n; v++)
+        key[v] = (label_key_t) { g->label[v], v };
+    qsort(key, g->n, sizeof *key, cmp_label_key);
+    for (int i = 0; i < g->n; i++) {
+        vv[i] = key[i].v;
+        pos[vv[i]] = i;
+    }
+    free(key);
+}
+
+unsigned int sparse_mcs(sparse_graph_t *g0, sparse_graph_t *g1, unsigned int floor, bool connected, bool (*stop)(unsigned int), bool verbose, int *sol) {
+    search_t s;
+    memset(&s, 0, sizeof s);
+    s.g0 = g0;
+    s.g1 = g1;
+    int min_n = g0->n < g1->n ? g0->n : g1->n, max_n = g0->n > g1->n ? g0->n : g1->n;
+    s.left = malloc(g0->n * sizeof *s.left + 1);
+    s.right = malloc(g1->n * sizeof *s.right + 1);
+    s.pos0 = malloc(g0->n * sizeof *s.pos0 + 1);
+    s.pos1 = malloc(g1->n * sizeof *s.pos1 + 1);
+    s.next_twin0 = malloc(g0->n * sizeof *s.next_twin0 + 1);
+    s.moved0 = malloc((max_n + 1) * sizeof *s.moved0);
+    s.moved1 = malloc((max_n + 1) * sizeof *s.moved1);
+    s.value0 = malloc(g0->n + 1);
+    s.value1 = malloc(g1->n + 1);
+    s.keys = malloc(max_n * sizeof *s.keys + 1);
+    s.current = malloc(2 * min_n * sizeof *s.current + 1);
+    s.best = malloc(2 * min_n * sizeof *s.best + 1);
+    s.floor = floor;
+    s.connected = connected;
+    s.stop = stop;
+    s.verbose = verbose;
+    for (unsigned int k = 0; k < g0->offset[g0->n]; k++) s.multiway |= g0->value[k] != 1;
+    for (unsigned int k = 0; k < g1->offset[g1->n]; k++) s.multiway |= g1->value[k] != 1;
+
+    // the twins of v follow v, which is the smallest of its class
+    for (int v = 0; v < g0->n; v++)
+        s.next_twin0[v] = -1;
+    for (int v = g0->n - 1; v >= 0; v--) {
+        if ((int) g0->twin[v] != v) {
+            s.next_twin0[v] = s.next_twin0[g0->twin[v]];
+            s.next_twin0[g0->twin[v]] = v;
+        }
+    }
+
+    // One domain per vertex label found in both graphs
+    sort_by_label(g0, s.left, s.pos0);
+    sort_by_label(g1, s.right, s.pos1);
+    domain_t *domains = malloc((min_n + 1) * sizeof *domains);
+    int len = 0;
+    for (int l = 0, r = 0; l < g0->n && r < g1->n; ) {
+        unsigned int label = g0->label[s.left[l]];
+        if (label < g1->label[s.right[r]]) {
+            l++;
+        } else if (label > g1->label[s.right[r]]) {
+            r++;
+        } else {
+            int start_l = l, start_r = r;
+            while (l < g0->n && g0->label[s.left[l]] == label) l++;
+            while (r < g1->n && g1->label[s.right[r]] == label) r++;
+            domains[len++] = (domain_t) { start_l, start_r, l - start_l, r - start_r, false };
+        }
+    }
+    if (verbose) printf("sparse engine: %u + %u edges, %d domains\n", sparse_edge_count(g0) / 2, sparse_edge_count(g1) / 2, len);
+
+    solve(&s, domains, len);
+
+    memcpy(sol, s.best, 2 * s.best_len * sizeof *sol);
+    free(domains);
+    free(s.left);
+    free(s.right);
+    free(s.pos0);
+    free(s.pos1);
+    free(s.next_twin0);
+    free(s.moved0);
+    free(s.moved1);
+    free(s.value0);
+    free(s.value1);
+    free(s.keys);
+    free(s.current);
+    free(s.best);
+    return s.best_len;
+}
+
+// Every mapped neighbour of v must be mapped to a neighbour of w by an edge
+// of the same value, and w must have as many mapped neighbours
+bool sparse_check(sparse_graph_t *g0, sparse_graph_t *g1, int *sol, unsigned int len) {
+    int *map0 = malloc(g0->n * sizeof *map0 + 1), *map1 = malloc(g1->n * sizeof *map1 + 1);
+    bool ok = true;
+    for (int v = 0; v < g0->n; v++) map0[v] = -1;
+    for (int w = 0; w < g1->n; w++) map1[w] = -1;
+    for (unsigned int i = 0; i < len && ok; i++) {
+        int v = sol[2 * i], w = sol[2 * i + 1];
+        ok = v >= 0 && v < g0->n && w >= 0 && w < g1->n && map0[v] == -1 && map1[w] == -1 && g0->label[v] == g1->label[w];
+        if (ok) {
+            map0[v] = w;
+            map1[w] = v;
+        }
+    }
+    for (unsigned int i = 0; i < len && ok; i++) {
+        int v = sol[2 * i], w = sol[2 * i + 1], mapped0 = 0, mapped1 = 0;
+        for (unsigned int k = g0->offset[v]; k < g0->offset[v + 1] && ok; k++) {
+            int x = g0->adj[k];
+            if (map0[x] == -1) continue;
+            mapped0++;
+            ok = sparse_value(g1, w, map0[x]) == g0->value[k];
+        }
+        for (unsigned int k = g1->offset[w]; k < g1->offset[w + 1]; k++)
+            mapped1 += map1[g1->adj[k]] != -1;
+        ok = ok && mapped0 == mapped1;
+    }
+    free(map0);
+    free(map1);
+    return ok;
+}
+
+bool sparse_pays_off(sparse_graph_t *g0, sparse_graph_t *g1) {
+    if (g0->n < SPARSE_MIN_VERTICES && g1->n < SPARSE_MIN_VERTICES)
+        return false;
+    double density0 = g0->n > 1 ? (double) sparse_edge_count(g0) / ((double) g0->n * (g0->n - 1)) : 0;
+    double density1 = g1->n > 1 ? (double) sparse_edge_count(g1) / ((double) g1->n * (g1->n - 1)) : 0;
+    return density0 <= SPARSE_MAX_DENSITY && density1 <= SPARSE_MAX_DENSITY;
+}
@@ -0,0 +1,49 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef SPARSE_H_
+#define SPARSE_H_
+
+#include "graph.h"
+
+#include <stdbool.h>
+
+// Maximum common induced subgraph of two graphs kept as adjacency lists, with
+// the bidomain search of the dense engine. The domains of a node are slices of
+// two vertex arrays, in increasing order of position, and every vertex knows
+// its position: a domain is split by moving the neighbours of v (w) to its
+// front, found by binary search on the domains, so a node costs the degrees
+// of v and w and the number of domains instead of the number of vertices.
+// Edge labels and directions split the moved vertices by value, as in the
+// dense engine. With connected, only the domains adjacent to the mapping are
+// branched on once it is not empty.
+//
+// Branches that cannot beat max(incumbent, floor) are pruned, and the search
+// returns as soon as stop() is true; stop() is given the incumbent size.
+// The graphs need their twins. The mapping is stored in sol as v0 w0 v1 w1
+// ..., its size is returned.
+unsigned int sparse_mcs(sparse_graph_t *g0, sparse_graph_t *g1, unsigned int floor, bool connected, bool (*stop)(unsigned int), bool verbose, int *sol);
+
+// True if sol, of len pairs, is a common induced subgraph of g0 and g1
+bool sparse_check(sparse_graph_t *g0, sparse_graph_t *g1, int *sol, unsigned int len);
+
+// Whether the sparse engine is worth using: graphs large enough for the
+// adjacency matrices to weigh, and sparse enough for the lists to be short.
+bool sparse_pays_off(sparse_graph_t *g0, sparse_graph_t *g1);
+
+#endif /* SPARSE_H_ */
@@ -31,7 +31,12 @@
 
 #include "graph.h"
 
-#define SPLIT_LEVEL 6
+#define SPLIT_LEVEL 6        // default depth up to which the search asks for help
+#define MAX_SPLIT_LEVEL 16
+
+extern int split_level;
+extern bool labelled;        // match the vertex and edge labels
+extern bool directed;        // match arcs with arcs of the same direction
 
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
@@ -66,7 +71,7 @@ typedef struct bidomain_list_s {
 }bidomain_list_t;
 
 typedef struct position_s{
-	int vals[SPLIT_LEVEL +1];
+	int vals[MAX_SPLIT_LEVEL +1];
 	int depth;
 }position_t;
 
@@ -33,8 +33,13 @@ static struct argp_option options[] = {
 		{"connected", 'c', 0, 0, "Search only for connected subgraphs"},
 		{"timeout", 't', "TIMEOUT", 0, "Set timeout of TIMEOUT milliseconds"},
 		{"lad", 'l', 0, 0, "Read LAD format"},
+		{"labelled", 'L', 0, 0, "Match the vertex and edge labels of binary files"},
+		{"directed", 'i', 0, 0, "Read the graphs as directed, and match arcs with arcs of the same direction"},
 		{"quiet", 'q', 0, 0, "Quiet output"},
 		{"verbose", 'v', 0, 0, "Verbose output"},
+		{"at-least", 'a', "K", 0, "Stop as soon as a common subgraph of K vertices is found, or proven not to exist"},
+		{"ratio", 'r', "R", 0, "Same as --at-least with K = R * min(n0,n1), rounded up"},
+		{"split-level", 's', "LEVEL", 0, "Split the search among threads down to depth LEVEL"},
 		{ 0 }
 };
 
@@ -45,6 +50,8 @@ static struct {
 	bool lad;
 	int timeout;
 	bool connected;
+	int at_least;
+	double ratio;
 	char *filename1;
 	char *filename2;
 	int arg_num;
@@ -57,6 +64,8 @@ void set_default_arguments() {
 	arguments.lad = false;
 	arguments.timeout = 0;
 	arguments.connected = false;
+	arguments.at_least = 0;
+	arguments.ratio = 0;
 	arguments.filename1 = NULL;
 	arguments.filename2 = NULL;
 	arguments.arg_num = 0;
@@ -73,6 +82,12 @@ error_t parse_opt (int key, char *arg, struct argp_state *state) {
 	case 'l':
 	    arguments.lad = true;
 	    break;
+	case 'L':
+		labelled = true;
+		break;
+	case 'i':
+		directed = true;
+		break;
 	case 'q':
 		arguments.quiet = true;
 		break;
@@ -82,6 +97,15 @@ error_t parse_opt (int key, char *arg, struct argp_state *state) {
 	case 'v':
 		arguments.verbose = true;
 		break;
+	case 'a':
+		arguments.at_least = strtol(arg, NULL, 10);
+		break;
+	case 'r':
+		arguments.ratio = strtod(arg, NULL);
+		break;
+	case 's':
+		split_level = MIN((int)strtol(arg, NULL, 10), MAX_SPLIT_LEVEL);
+		break;
 	case ARGP_KEY_ARG:
 		if (arguments.arg_num == 0) {
 			arguments.filename1 = arg;
@@ -107,6 +131,10 @@ static struct argp argp = { options, parse_opt, args_doc};
 // ****************************************************************************************************************************
 // ****************************************************************************************************************************
 struct timespec start;
+int split_level = SPLIT_LEVEL;
+bool labelled = false;
+bool directed = false;
+int threshold = 0;	// --at-least/--ratio: stop at the first mapping of this size, 0 to search for the optimum
 
 void solve (const unsigned int depth, graph_t *g0, graph_t *g1, atomic_incumbent *global_incumbent,
 		vtx_pair_list_t **per_thread_incumbents, vtx_pair_list_t *current, bidomain_list_t *domains,
@@ -131,7 +159,7 @@ void solve_nopar(int depth, graph_t *g0, graph_t *g1, atomic_incumbent *global_i
         arguments.timeout = -1;
     }
     if (arguments.timeout == -1) return;
-    
+    if (threshold && get_global_incumbent(global_incumbent) >= threshold) return;
 
 	if(my_incumbent->len < current->len){
 		set_incumbent(current, my_incumbent, arguments.verbose);
@@ -162,6 +190,8 @@ void solve_nopar(int depth, graph_t *g0, graph_t *g1, atomic_incumbent *global_i
 
 			right[bd->r + idx] = right[bd->r + bd->right_len];
 			right[bd->r + bd->right_len] = w;
+			if (twin_already_tried(right, bd->r, bd->right_len, w, g1->twin))
+				continue;
 
 			bidomain_list_t *new_domains = filter_domains(domains, left, right, g0, g1, v, w);
 			current->vals[current->len++] = (vtx_pair_t){.v=v, .w=w};
@@ -172,6 +202,7 @@ void solve_nopar(int depth, graph_t *g0, graph_t *g1, atomic_incumbent *global_i
 		} else {
 			/* try to leave unmatched vertex v */
 			bd->right_len++;
+			remove_twins_from_left_domain(left, bd, v, g0->twin);
 			if (bd->left_len == 0)
 				remove_bidomain(domains, bd_idx);
 			solve_nopar(depth + 1, g0, g1, global_incumbent, my_incumbent, current, domains, left, right, thread_idx);
@@ -197,9 +228,11 @@ void main_function(args_t *args){
 
 			if (i == args->next_i) {
 				args->next_i = atomic_fetch_add(args->shared_i, 1);
+				if (twin_already_tried(args->right, args->bd->r, args->bd->right_len, w, args->g1->twin))
+					continue;
 				bidomain_list_t *new_domains= filter_domains(args->domains, args->left, args->right, args->g0, args->g1, v, w);
 				args->current->vals[args->current->len++] = (vtx_pair_t){.v=v, .w=w};
-				if (args->depth > SPLIT_LEVEL) {
+				if (args->depth > split_level) {
 					solve_nopar(args->depth + 1, args->g0, args->g1, args->global_incumbent, args->per_thread_incumbents[args->thread_idx], args->current, new_domains, args->left, args->right, args->thread_idx);
 				}
 				else {
@@ -215,12 +248,13 @@ void main_function(args_t *args){
 		else {
 			// Last assign is null. Keep it in the loop to simplify parallelism.
 			args->bd->right_len++;
+			remove_twins_from_left_domain(args->left, args->bd, v, args->g0->twin);
 			if (args->bd->left_len == 0)
 				remove_bidomain(args->domains, args->bd_idx);
 
 			if (i == args->next_i) {
 				args->next_i = atomic_fetch_add(args->shared_i, 1);
-				if (args->depth > SPLIT_LEVEL) {
+				if (args->depth > split_level) {
 					solve_nopar(args->depth + 1, args->g0, args->g1, args->global_incumbent, args->per_thread_incumbents[args->thread_idx], args->current, args->domains, args->left, args->right, args->thread_idx);
 				}
 				else {
@@ -265,9 +299,11 @@ void helper_function(args_t *args){
 			help_right[help_bd->r + help_bd->right_len] = help_w;
 			if (i == next_i) {
 				next_i = atomic_fetch_add(args->shared_i, 1);
+				if (twin_already_tried(help_right, help_bd->r, help_bd->right_len, help_w, args->g1->twin))
+					continue;
 				bidomain_list_t *new_domains = filter_domains(help_domains, help_left, help_right, args->g0, args->g1, help_v, help_w);
 				help_current->vals[help_current->len++] = (vtx_pair_t){.v=help_v, .w=help_w};
-				if (args->depth > SPLIT_LEVEL) {
+				if (args->depth > split_level) {
 					solve_nopar(args->depth + 1, args->g0, args->g1, args->global_incumbent, args->per_thread_incumbents[args->thread_idx], help_current, new_domains, help_left, help_right, args->thread_idx);
 				}
 				else {
@@ -283,12 +319,13 @@ void helper_function(args_t *args){
 		else {
 			// Last assign is null. Keep it in the loop to simplify parallelism.
 			help_bd->right_len++;
+			remove_twins_from_left_domain(help_left, help_bd, help_v, args->g0->twin);
 			if (help_bd->left_len == 0)
 				remove_bidomain(help_domains, help_bd_idx);
 
 			if (i == next_i) {
 				next_i = atomic_fetch_add(args->shared_i, 1);
-				if (args->depth > SPLIT_LEVEL) {
+				if (args->depth > split_level) {
 					solve_nopar(args->depth + 1, args->g0, args->g1, args->global_incumbent, args->per_thread_incumbents[args->thread_idx], help_current, help_domains, help_left, help_right, args->thread_idx);
 				}
 				else {
@@ -311,6 +348,7 @@ void solve (const unsigned int depth, graph_t *g0, graph_t *g1, atomic_incumbent
         arguments.timeout = -1;
     }
     if (arguments.timeout == -1) return;
+    if (threshold && get_global_incumbent(global_incumbent) >= threshold) return;
     
 	if(per_thread_incumbents[thread_idx]->len < current->len){
 		set_incumbent(current, per_thread_incumbents[thread_idx], arguments.verbose);
@@ -338,7 +376,7 @@ void solve (const unsigned int depth, graph_t *g0, graph_t *g1, atomic_incumbent
 			position, help_me, thread_idx, shared_i, // @suppress("Type cannot be resolved")
 			i_end , bd_idx, bd, next_i);;
 
-	if (depth <= SPLIT_LEVEL){
+	if (depth <= split_level){
 		args_t *helper_args = copy_wrap_args(depth, g0, g1, per_thread_incumbents,
 				current, domains, left, right, global_incumbent,// @suppress("Type cannot be resolved")
 				position, help_me, thread_idx, shared_i, // @suppress("Type cannot be resolved")
@@ -376,34 +414,48 @@ vtx_pair_list_t *mcs(graph_t *g0, graph_t *g1){
 
 	int *left = malloc(g0->n* sizeof *left );  // the buffer of vertex indices for the left partitions
 	int *right = malloc(g1->n* sizeof *right );  // the buffer of vertex indices for the right partitions
-	int l = 0, r = 0;  // next free index in left and right
-
-	// Create a bidomain for vertices without loops (label 0),
-	// and another for vertices with loops (label 1)
-	for (int label=0; label<=1; label++) {
-		int start_l = l;
-		int start_r = r;
-		for (int i=0; i<g0->n; i++)
-			if (g0->label[i]==label)
-				left[l++] = i;
-		for (int i=0; i<g1->n; i++)
-			if (g1->label[i]==label)
-				right[r++] = i;
-
-		int left_len = l - start_l;
-		int right_len = r - start_r;
-		if (left_len && right_len)
-			add_bidomain(domains, start_l, start_r, left_len, right_len, false);
+
+	// Create a bidomain for each vertex label found in both graphs,
+	// vertices with loops having labels of their own
+	for (int i=0; i<g0->n; i++) left[i] = i;
+	for (int i=0; i<g1->n; i++) right[i] = i;
+	INSERTION_SORT(int, left, g0->n, g0->label[left[j-1]] > g0->label[left[j]])
+	INSERTION_SORT(int, right, g1->n, g1->label[right[j-1]] > g1->label[right[j]])
+	for (int l = 0, r = 0; l < g0->n && r < g1->n; ) {
+		unsigned int label = g0->label[left[l]];
+		if (label < g1->label[right[r]]) {
+			l++;
+		} else if (label > g1->label[right[r]]) {
+			r++;
+		} else {
+			int start_l = l, start_r = r;
+			while (l < g0->n && g0->label[left[l]] == label) l++;
+			while (r < g1->n && g1->label[right[r]] == label) r++;
+			add_bidomain(domains, start_l, start_r, l - start_l, r - start_r, false);
+		}
 	}
 
 
+	// With a threshold the global incumbent starts at threshold-1: the bound then
+	// prunes every branch that cannot reach it, the root one included.
+	if (threshold) {
+		update_global_incumbent(&incumbent, threshold - 1);
+		if (calc_bound(domains) < threshold && !arguments.quiet)
+			printf("root bound %d below threshold\n", calc_bound(domains));
+	}
+
 	threadpool_t *help_me = init_threadpool(N_THREAD-1);
 	solve (0, g0, g1, &incumbent, per_thread_incumbents, current, domains, left, right, (position_t){.depth=0, .vals={0,0,0,0,0}}, help_me, 0);
 	kill_workers(help_me);
 
+	// the longest per-thread incumbent, the global one may be a threshold-1 placeholder
 	vtx_pair_list_t *solution= NULL;
+	unsigned int best = 0;
+	for(int i = 1; i < N_THREAD; i++)
+		if(per_thread_incumbents[i]->len > per_thread_incumbents[best]->len)
+			best = i;
 	for(int i = 0; i < N_THREAD; i++){
-		if(per_thread_incumbents[i]->len == get_global_incumbent(&incumbent)){
+		if(i == best){
 			qsort(per_thread_incumbents[i]->vals, per_thread_incumbents[i]->len, sizeof(vtx_pair_t), cmp );
 			solution = copy_solution(per_thread_incumbents[i]);
 		}
@@ -419,6 +471,37 @@ vtx_pair_list_t *mcs(graph_t *g0, graph_t *g1){
 
 }
 
+// The two graphs are read, and then sorted, each by a thread of its own
+typedef struct prepare_s {
+	char *filename;
+	graph_t *g;
+	bool ascending;
+}prepare_t;
+
+void *read_graph(void *arg){
+	prepare_t *p = arg;
+	p->g = calloc(1, sizeof *p->g);
+	readGraph(p->filename, p->g, arguments.lad ? 'L' : 'B', directed, labelled);
+	return NULL;
+}
+
+void *sort_graph(void *arg){
+	prepare_t *p = arg;
+	p->g = sort_vertices_by_degree(p->g, p->ascending);
+	return NULL;
+}
+
+// Runs f on the second graph in a new thread while running it on the first
+void on_both_graphs(void *(*f)(void *), prepare_t *prep){
+	pthread_t thread;
+	bool spawned = pthread_create(&thread, NULL, f, &prep[1]) == 0;
+	f(&prep[0]);
+	if (spawned)
+		pthread_join(thread, NULL);
+	else
+		f(&prep[1]);
+}
+
 int main(int argc, char** argv){
 	set_default_arguments();
 	argp_parse(&argp, argc, argv, 0, 0, 0);
@@ -427,14 +510,23 @@ int main(int argc, char** argv){
 	double time_elapsed;
 
 	char format = arguments.lad ? 'L' : 'B';
-	graph_t *g0 = calloc(1, sizeof *g0 );
-	readGraph(arguments.filename1, g0, format);
-	graph_t *g1 = calloc(1, sizeof *g1 );
-	readGraph(arguments.filename2, g1, format);
-	g0 = sort_vertices_by_degree(g0, (graph_edge_count(g1) > g1->n*(g1->n-1)/2));
-	g1 = sort_vertices_by_degree(g1, (graph_edge_count(g0) > g0->n*(g0->n-1)/2));
+	prepare_t prep[2] = { { .filename = arguments.filename1 }, { .filename = arguments.filename2 } };
+	on_both_graphs(read_graph, prep);
+	if (format != 'L')
+		printf("%d vertices\n%d vertices\n", prep[0].g->n, prep[1].g->n);
+	for (int k = 0; k < 2; k++)
+		prep[k].ascending = graph_edge_count(prep[1-k].g) > prep[1-k].g->n*(prep[1-k].g->n-1)/2;
+	on_both_graphs(sort_graph, prep);
+	graph_t *g0 = prep[0].g, *g1 = prep[1].g;
+
 
 
+	if (arguments.ratio > 0) {
+		double k = arguments.ratio * MIN(g0->n, g1->n);
+		threshold = (int)k + ((int)k < k);
+	} else {
+		threshold = arguments.at_least;
+	}
 
 	clock_gettime(CLOCK_MONOTONIC, &start);
 	vtx_pair_list_t *solution = mcs(g0, g1);
@@ -446,6 +538,8 @@ int main(int argc, char** argv){
 	
 		if (arguments.timeout == -1){
         	printf("TIMEOUT\n");
+		} else if (threshold) {
+			printf("Threshold %d %s\n", threshold, solution->len >= threshold ? "reached" : "not reachable");
 		}
 	
 		for(int j = 0; j < solution->len; j++)
@@ -90,7 +90,7 @@ void kill_workers(threadpool_t *help_me){
 bool compare_pos(position_t *a, position_t* b){
 	if(a->depth < b->depth) return true;
 	else if (a->depth > b->depth) return false;
-	for(int i = 0; i < SPLIT_LEVEL + 1; i++){
+	for(int i = 0; i < MAX_SPLIT_LEVEL + 1; i++){
 		if(a->vals[i] < b->vals[i]) return true;
 		else if(a->vals[i] > b->vals[i]) return false;
 	}
@@ -91,6 +91,27 @@ void remove_vtx_from_left_domain(int *left, bidomain_t *bd, int v){
 	bd->left_len--;
 }
 
+// Once v has been left unmatched, its twins in the same domain can be left
+// unmatched too: any mapping using one of them is mirrored by a mapping using v.
+void remove_twins_from_left_domain(int *left, bidomain_t *bd, int v, unsigned int *twin){
+	for (int i = bd->left_len - 1; i >= 0; i--) {
+		if (twin[left[bd->l + i]] == twin[v]) {
+			swap(&left[bd->l + i], &left[bd->l + bd->left_len-1]);
+			bd->left_len--;
+		}
+	}
+}
+
+// True if a twin of w with a smaller index is still in the right domain:
+// w's are tried in increasing order, so that twin already covered this branch.
+bool twin_already_tried(int *right, int start_idx, int len, int w, unsigned int *twin){
+	if (twin[w] == w) return false;
+	for (int i=0; i<len; i++)
+		if (right[start_idx + i] < w && twin[right[start_idx + i]] == twin[w])
+			return true;
+	return false;
+}
+
 int index_of_next_smallest(int *arr, int start_idx, int len, int w){
 	int idx = -1;
 	int smallest = INT_MAX;
@@ -137,6 +158,30 @@ int partition(int *all_vv, int start, int len, unsigned char *adjrow) {
 	return i;
 }
 
+// Splits the vertices adjacent to v and w, at left[l] and right[r], by the
+// label of the edge and, in directed graphs, its direction: both sides are
+// sorted by adjacency value, and every value found on both sides makes a
+// bidomain.
+static void add_domains_by_edge_label(bidomain_list_t *new_d, int *left, int *right, int l, int r, int left_len, int right_len, unsigned char *adjrow0, unsigned char *adjrow1) {
+	int *vv0 = left + l, *vv1 = right + r;
+	INSERTION_SORT(int, vv0, left_len, adjrow0[vv0[j-1]] > adjrow0[vv0[j]])
+	INSERTION_SORT(int, vv1, right_len, adjrow1[vv1[j-1]] > adjrow1[vv1[j]])
+	int i = 0, j = 0;
+	while (i < left_len && j < right_len) {
+		unsigned char label0 = adjrow0[vv0[i]], label1 = adjrow1[vv1[j]];
+		if (label0 < label1) {
+			i++;
+		} else if (label0 > label1) {
+			j++;
+		} else {
+			int start_i = i, start_j = j;
+			while (i < left_len && adjrow0[vv0[i]] == label0) i++;
+			while (j < right_len && adjrow1[vv1[j]] == label0) j++;
+			add_bidomain(new_d, l+start_i, r+start_j, i-start_i, j-start_j, true);
+		}
+	}
+}
+
 bidomain_list_t *filter_domains(bidomain_list_t *domains, int* left, int* right, graph_t *g0, graph_t *g1, int v, int w){
 
 	bidomain_list_t *new_d = malloc(sizeof *new_d);
@@ -156,8 +201,12 @@ bidomain_list_t *filter_domains(bidomain_list_t *domains, int* left, int* right,
 		int right_len_noedge = old_bd->right_len - right_len;
 		if (left_len_noedge && right_len_noedge)
 			add_bidomain(new_d, l+left_len, r+right_len, left_len_noedge, right_len_noedge, old_bd->is_adjacent);
-		if (left_len && right_len)
-			add_bidomain(new_d, l, r, left_len, right_len, true);
+		if (left_len && right_len) {
+			if (labelled || directed)
+				add_domains_by_edge_label(new_d, left, right, l, r, left_len, right_len, g0->adjmat[v], g1->adjmat[w]);
+			else
+				add_bidomain(new_d, l, r, left_len, right_len, true);
+		}
 	}
 	return new_d;
 }
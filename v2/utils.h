@@ -32,6 +32,8 @@ void set_incumbent(vtx_pair_list_t *current, vtx_pair_list_t *incumbent, bool ve
 void remove_bidomain(bidomain_list_t *list, int idx);
 int find_min_value(int *arr, int start_idx, int len);
 void remove_vtx_from_left_domain(int *left, bidomain_t *bd, int v);
+void remove_twins_from_left_domain(int *left, bidomain_t *bd, int v, unsigned int *twin);
+bool twin_already_tried(int *right, int start_idx, int len, int w, unsigned int *twin);
 int index_of_next_smallest(int *arr, int start, int len, int w);
 int select_bidomain(bidomain_list_t *domains, int *left, int current_matching_size, bool connected);
 bidomain_list_t *filter_domains(bidomain_list_t *domains, int* left, int* right, graph_t *g0, graph_t *g1, int v, int w);
@@ -23,6 +23,12 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static void fail(char* msg) {
     printf("%s\n", msg);
@@ -30,112 +36,230 @@ static void fail(char* msg) {
 }
 
 unsigned int* calculate_degrees(graph_t *g) {
-	short int size = g->n;
-	unsigned int *degree = calloc(size, sizeof *degree);
+	unsigned int *degree = calloc(g->n, sizeof *degree);
 	for (int v = 0; v < g->n; v++)
 		for (int w = 0; w < g->n; w++)
 			if (g->adjmat[v][w]) degree[v]++;
 	return degree;
 }
 
-void add_edge(graph_t *g, int v, int w) {
-    if (v != w) {
-        g->adjmat[v][w] = 1;
-        g->adjmat[w][v] = 1;
+static unsigned long long vertex_key(unsigned long long x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+static bool are_twins(graph_t *g, int u, int v) {
+	if (g->label[u] != g->label[v]) return false;
+	if (g->adjmat[u][v] != g->adjmat[v][u]) return false;   // an arc between them
+	for (int x = 0; x < g->n; x++)
+		if (x != u && x != v && g->adjmat[u][x] != g->adjmat[v][x])
+			return false;
+	return true;
+}
+
+// twin[v] is the smallest vertex u whose neighbourhood, apart from u and v
+// themselves, is the same as the one of v (true or false twins).
+// Swapping two twins is an automorphism of g, so the search only has to try
+// one vertex per twin class. Candidates are found by hashing the open and
+// closed neighbourhoods, so the pass is linear in the size of adjmat.
+unsigned int* calculate_twins(graph_t *g) {
+	unsigned int *twin = malloc(g->n * sizeof *twin);
+	unsigned long long *hash = calloc(g->n, sizeof *hash);
+	for (int v = 0; v < g->n; v++)
+		for (int w = 0; w < g->n; w++)
+			if (g->adjmat[v][w]) hash[v] += vertex_key(w);
+	for (int v = 0; v < g->n; v++) {
+		twin[v] = v;
+		for (int u = 0; u < v; u++) {
+			if (twin[u] != u) continue;
+			if (hash[u] != hash[v] && hash[u] + vertex_key(u) != hash[v] + vertex_key(v)) continue;
+			if (are_twins(g, u, v)) {
+				twin[v] = u;
+				break;
+			}
+		}
+	}
+	free(hash);
+	return twin;
+}
+
+// The adjacency matrix holds 1 + the label of each edge, 0 for no edge. In
+// a directed graph, adjmat[v][w] holds 1 + the label of the arc from v to w
+// in its low 4 bits and 1 + the label of the arc from w to v in its high 4
+// bits, so that refining by v splits the neighbours into out, in and both.
+void add_edge(graph_t *g, int v, int w, bool directed, unsigned int label) {
+    if (v != w && directed) {
+        g->adjmat[v][w] = (g->adjmat[v][w] & 0xf0) | (1 + label);
+        g->adjmat[w][v] = (g->adjmat[w][v] & 0x0f) | ((1 + label) << 4);
+    } else if (v != w) {
+        g->adjmat[v][w] = 1 + label;
+        g->adjmat[w][v] = 1 + label;
     } else {
-        // To indicate that a vertex has a loop, we set its label to 1
-        g->label[v] = 1;
+        // To indicate that a vertex has a loop, we set the top bit of its label
+        g->label[v] |= 1u << 31;
     }
 }
 
-unsigned int read_word(FILE *fp) {
-    unsigned char a[2];
-    if (fread(a, 1, 2, fp) != 2)
+// The adjacency matrix is one block: the row pointers followed by the
+// n rows, so a graph costs two allocations whatever its size.
+void alloc_graph(graph_t *g, int n) {
+    g->n = n;
+    g->label = calloc(n, sizeof *g->label);
+    g->adjmat = calloc(1, n * sizeof *g->adjmat + (size_t) n * n);
+    unsigned char *rows = (unsigned char *) (g->adjmat + n);
+    for (int i = 0; i < n; i++)
+        g->adjmat[i] = rows + (size_t) i * n;
+}
+
+// Maps filename read-only; returns NULL and *size 0 for an empty file.
+static const unsigned char *map_file(char *filename, size_t *size) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+        fail("Cannot open file");
+    *size = st.st_size;
+    const unsigned char *map = NULL;
+    if (*size > 0) {
+        map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            fail("Cannot map file");
+        madvise((void *) map, *size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    return map;
+}
+
+static void unmap_file(const unsigned char *map, size_t size) {
+    if (map != NULL) munmap((void *) map, size);
+}
+
+static unsigned int next_word(const unsigned char **p, const unsigned char *end) {
+    if (end - *p < 2)
         fail("Error reading file.\n");
-    return (unsigned int)a[0] | (((unsigned int)a[1]) << 8);
+    unsigned int w = (unsigned int)(*p)[0] | (((unsigned int)(*p)[1]) << 8);
+    *p += 2;
+    return w;
 }
 
+// The binary format is a stream of little-endian 16-bit words: the number
+// of vertices, a label per vertex, then for each vertex the length of its
+// edge list and a (target, label) pair per edge. The file is mapped and
+// decoded in one pass, checking every word against the end of the map.
+// With labelled, the labels are read as in the labelled instances of the
+// ARG database: only the top bits of each word count, as many as give
+// about n/3 distinct labels. Edge labels keep at most EDGE_LABEL_BITS of
+// them, ARC_LABEL_BITS if directed, so that the adjacency matrix stays a
+// byte per pair.
 // Precondition: *g is already zeroed out
-// returns max edge label
-void readBinaryGraph(char* filename, graph_t* g) {
-    FILE* f;
-	int i;
-    if ((f=fopen(filename, "rb"))==NULL)
-        fail("Cannot open file");
+void readBinaryGraph(char* filename, graph_t* g, bool directed, bool labelled) {
+    size_t size;
+    const unsigned char *map = map_file(filename, &size);
+    const unsigned char *p = map, *end = map + size;
 
-    unsigned int nvertices = read_word(f);
-    g->n = nvertices;
-    g->label = calloc(g->n, sizeof *g->label);
-    g->adjmat = calloc(g->n, sizeof *g->adjmat);
-    for(i = 0; i < g->n; i++)
-    	g->adjmat[i] = calloc(g->n, sizeof *g->adjmat[i]);
-    printf("%d vertices\n", nvertices);
-    
-    printf("paolo2");
-    for (int i=0; i<nvertices; i++) {
-        read_word(f);   // ignore label
+    unsigned int nvertices = next_word(&p, end);
+    alloc_graph(g, nvertices);
+    if ((size_t) (end - p) < 2 * (size_t) nvertices)
+        fail("Error reading file.\n");
+    int bits = 0;
+    while ((2u << bits) < nvertices * 33 / 100)
+        bits++;
+    int max_bits = directed ? ARC_LABEL_BITS : EDGE_LABEL_BITS;
+    int edge_bits = bits < max_bits ? bits : max_bits;
+    for (unsigned int i=0; i<nvertices; i++) {
+        unsigned int label = next_word(&p, end);
+        if (labelled) g->label[i] = label >> (16 - bits);
     }
 
-    for (int i=0; i<nvertices; i++) {
-        int len = read_word(f);
-        for (int j=0; j<len; j++) {
-            int target = read_word(f);
-            read_word(f); // ignore label
-            add_edge(g, i, target);
+    for (unsigned int i=0; i<nvertices; i++) {
+        unsigned int len = next_word(&p, end);
+        if ((size_t) (end - p) < 4 * (size_t) len)
+            fail("Error reading file.\n");
+        for (unsigned int j=0; j<len; j++) {
+            unsigned int target = next_word(&p, end);
+            unsigned int label = next_word(&p, end);
+            if (target >= nvertices)
+                fail("Edge to a nonexistent vertex.\n");
+            add_edge(g, i, target, directed, labelled ? label >> (16 - edge_bits) : 0);
         }
     }
 	g->degree = calculate_degrees(g);
-    fclose(f);
+    unmap_file(map, size);
 }
 
-// Precondition: *g is already zeroed out
-void readLadGraph(char* filename, graph_t* g) {
-    FILE* f;
-    int i;
-    if ((f=fopen(filename, "r"))==NULL){
-        free(g);
-    	fail("Cannot open file");
+typedef struct lad_reader_s {
+    const unsigned char *p, *end;
+    char *filename;
+    int line;
+} lad_reader_t;
+
+static void lad_error(lad_reader_t *r, char *what) {
+    char msg[512];
+    snprintf(msg, sizeof msg, "%s:%d: %s", r->filename, r->line, what);
+    fail(msg);
+}
+
+// Next non-negative integer of the mapped text, skipping whitespace and
+// counting lines for the error messages.
+static int lad_int(lad_reader_t *r, char *what) {
+    const unsigned char *p = r->p;
+    while (p < r->end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        if (*p == '\n') r->line++;
+        p++;
     }
-    int nvertices = 0, w;
-    if (fscanf(f, "%d", &nvertices) != 1)
-        fail("Number of vertices not read correctly.\n");
-    g->n = nvertices;
-    g->label = calloc(g->n, sizeof *g->label);
-    g->adjmat = calloc(g->n, sizeof *g->adjmat);
-    for(i = 0; i < g->n; i++)
-    	g->adjmat[i] = calloc(g->n, sizeof *g->adjmat[i]);
+    if (p == r->end || *p < '0' || *p > '9')
+        lad_error(r, what);
+    long long x = 0;
+    while (p < r->end && *p >= '0' && *p <= '9') {
+        x = x * 10 + (*p++ - '0');
+        if (x > INT_MAX) lad_error(r, "Number too large.");
+    }
+    r->p = p;
+    return (int) x;
+}
+
+// The LAD format is the number of vertices followed, for each vertex, by
+// its degree and its neighbours, its successors if directed. The file is
+// mapped and parsed in place.
+// Precondition: *g is already zeroed out
+void readLadGraph(char* filename, graph_t* g, bool directed) {
+    size_t size;
+    const unsigned char *map = map_file(filename, &size);
+    lad_reader_t r = { map, map + size, filename, 1 };
+    int nvertices = lad_int(&r, "Number of vertices not read correctly.");
+    alloc_graph(g, nvertices);
     for (int i=0; i<nvertices; i++) {
-        int edge_count;
-        if (fscanf(f, "%d", &edge_count) != 1)
-            fail("Number of edges not read correctly.\n");
+        int edge_count = lad_int(&r, "Number of edges not read correctly.");
         for (int j=0; j<edge_count; j++) {
-            if (fscanf(f, "%d", &w) != 1)
-                fail("An edge was not read correctly.\n");
-            add_edge(g, i, w);
+            int w = lad_int(&r, "An edge was not read correctly.");
+            if (w >= nvertices)
+                lad_error(&r, "Edge to a nonexistent vertex.");
+            add_edge(g, i, w, directed, 0);
         }
     }
 	g->degree = calculate_degrees(g);
-    fclose(f);
+    unmap_file(map, size);
 }
 
-void readGraph(char* filename, graph_t* g, char format) {
-    if (format=='L') readLadGraph(filename, g);
-    else if (format=='B') readBinaryGraph(filename, g);
+void readGraph(char* filename, graph_t* g, char format, bool directed, bool labelled) {
+    if (format=='L') readLadGraph(filename, g, directed);
+    else if (format=='B') readBinaryGraph(filename, g, directed, labelled);
     else fail("Unknown graph format\n");
 }
 
 graph_t *induced_subgraph(graph_t *g, int *vv) {
 	graph_t * subg = calloc(1, sizeof *subg);
-	subg->n = g->n;
-	subg->label = calloc(g->n, sizeof *subg->label);
-	subg->adjmat = calloc(g->n, sizeof *subg->adjmat);
-	for (int n = 0; n < g->n; n++) subg->adjmat[n] = calloc(g->n, sizeof *subg->adjmat[n]);
+	alloc_graph(subg, g->n);
 	for (int i = 0; i < subg->n; i++)
 		for (int j=0; j < subg->n; j++)
 			subg->adjmat[i][j] = g->adjmat[vv[i]][vv[j]];
-	for (int i=0; i<subg->n; i++)
+	subg->degree = malloc(g->n * sizeof *subg->degree + 1);
+	for (int i=0; i<subg->n; i++) {
 		subg->label[i] = g->label[vv[i]];
-	subg->degree = calculate_degrees(subg);
+		subg->degree[i] = g->degree[vv[i]];
+	}
+	subg->twin = calculate_twins(subg);
 	return subg;
 }
 
@@ -147,28 +271,64 @@ int graph_edge_count(graph_t *g) {
 }
 
 void free_graph(graph_t *g){
-	for(int i = 0; i < g->n; i++)
-		free(g->adjmat[i]);
 	free(g->adjmat);
 	free(g->label);
 	free(g->degree);
+	free(g->twin);
 	free(g);
 	return;
 }
 
-graph_t *sort_vertices_by_degree(graph_t *g, bool ascending ){
-	int *vv = malloc(g->n * sizeof *vv );
-	for (int i=0; i<g->n; i++) vv[i] = i;
-	if (ascending) {
-		INSERTION_SORT(int, vv, g->n, (g->degree[vv[j-1]] > g->degree[vv[j]]))
-	} else {
-		INSERTION_SORT(int, vv, g->n, (g->degree[vv[j-1]] < g->degree[vv[j]]))
+// Vertices of g by degree, ties by index, in O(n + max degree)
+static int *degree_order(unsigned int *degree, int n, bool ascending) {
+	unsigned int max_degree = 0;
+	for (int v = 0; v < n; v++)
+		if (degree[v] > max_degree) max_degree = degree[v];
+	unsigned int *start = calloc(max_degree + 2, sizeof *start);
+	for (int v = 0; v < n; v++)
+		start[(ascending ? degree[v] : max_degree - degree[v]) + 1]++;
+	for (unsigned int d = 0; d <= max_degree; d++)
+		start[d + 1] += start[d];
+	int *vv = malloc(n * sizeof *vv + 1);
+	for (int v = 0; v < n; v++)
+		vv[start[ascending ? degree[v] : max_degree - degree[v]]++] = v;
+	free(start);
+	return vv;
+}
+
+// Renumbers g in place so that vertex i is vertex vv[i] of g: the rows are
+// permuted as pointers, the entries of each row through one scratch row, and
+// the degrees move with their vertices instead of being counted again.
+void permute_graph(graph_t *g, int *vv) {
+	int n = g->n;
+	unsigned char **rows = malloc(n * sizeof *rows + 1), *row = malloc(n + 1);
+	unsigned int *label = malloc(n * sizeof *label + 1), *degree = malloc(n * sizeof *degree + 1);
+	for (int i = 0; i < n; i++) {
+		rows[i] = g->adjmat[vv[i]];
+		label[i] = g->label[vv[i]];
+		degree[i] = g->degree[vv[i]];
+	}
+	memcpy(g->adjmat, rows, n * sizeof *rows);
+	memcpy(g->label, label, n * sizeof *label);
+	memcpy(g->degree, degree, n * sizeof *degree);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++)
+			row[j] = g->adjmat[i][vv[j]];
+		memcpy(g->adjmat[i], row, n);
 	}
+	free(g->twin);
+	g->twin = calculate_twins(g);
+	free(rows);
+	free(row);
+	free(label);
+	free(degree);
+}
 
-	graph_t *g_sorted = induced_subgraph(g, vv);
+graph_t *sort_vertices_by_degree(graph_t *g, bool ascending ){
+	int *vv = degree_order(g->degree, g->n, ascending);
+	permute_graph(g, vv);
 	free(vv);
-	free_graph(g);
-	return g_sorted;
+	return g;
 }
 
 
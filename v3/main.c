@@ -29,6 +29,7 @@
 #include <time.h>
 
 #include "graph.h"
+#include "nogood.h"
 
 #define L   0
 #define R   1
@@ -54,8 +55,14 @@ static struct argp_option options[] = {
 		{"quiet", 'q', 0, 0, "Quiet output"},
 		{"verbose", 'v', 0, 0, "Verbose output"},
 		{"lad", 'l', 0, 0, "Read LAD format"},
+		{"labelled", 'L', 0, 0, "Match the vertex and edge labels of binary files"},
+		{"directed", 'i', 0, 0, "Read the graphs as directed, and match arcs with arcs of the same direction"},
 		{"timeout", 't', "timeout", 0, "Set timeout of TIMEOUT milliseconds"},
 		{"connected", 'c', 0, 0, "Solve max common CONNECTED subgraph problem"},
+		{"nogood-cache", 'g', "MB", 0, "Cache failed subproblems in a table of MB megabytes"},
+		{"k-down", 'k', 0, 0, "Look for a solution of size min(n0,n1)-k for k = 0, 1, 2, ..."},
+		{"at-least", 'a', "K", 0, "Stop as soon as a common subgraph of K vertices is found, or proven not to exist"},
+		{"ratio", 'r', "R", 0, "Same as --at-least with K = R * min(n0,n1), rounded up"},
 		{ 0 }
 };
 
@@ -66,7 +73,13 @@ static struct {
 	bool verbose;
 	bool connected;
 	bool lad;
+	bool labelled;
+	bool directed;
+	bool k_down;
     int timeout;
+	int nogood_mb;
+	int at_least;
+	double ratio;
 	char *filename1;
 	char *filename2;
 	int arg_num;
@@ -76,7 +89,13 @@ void set_default_arguments() {
 	arguments.quiet = false;
 	arguments.verbose = false;
 	arguments.lad = false;
+	arguments.labelled = false;
+	arguments.directed = false;
+	arguments.k_down = false;
     arguments.timeout = 0;
+	arguments.nogood_mb = 0;
+	arguments.at_least = 0;
+	arguments.ratio = 0;
 	arguments.connected = false;
 	arguments.filename1 = NULL;
 	arguments.filename2 = NULL;
@@ -87,6 +106,12 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 	case 'l':
 	arguments.lad = true;
 	break;
+	case 'L':
+		arguments.labelled = true;
+		break;
+	case 'i':
+		arguments.directed = true;
+		break;
 	case 'q':
 		arguments.quiet = true;
 		break;
@@ -99,6 +124,18 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 	case 'c':
 		arguments.connected = true;
 		break;
+	case 'g':
+		arguments.nogood_mb = strtol(arg, NULL, 10);
+		break;
+	case 'k':
+		arguments.k_down = true;
+		break;
+	case 'a':
+		arguments.at_least = strtol(arg, NULL, 10);
+		break;
+	case 'r':
+		arguments.ratio = strtod(arg, NULL);
+		break;
 	case ARGP_KEY_ARG:
 		if (arguments.arg_num == 0) {
 			arguments.filename1 = arg;
@@ -120,8 +157,11 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
 uchar **adjmat0, **adjmat1, n0, n1;
+uint *twin0, *twin1, *label0, *label1;
 uint max_dom = 0;
 struct timespec start;
+nogood_cache_t *nogood = NULL;
+uint target = 0;	// stop as soon as the incumbent reaches this size, 0 to search for the optimum
 
 void uchar_swap(uchar *a, uchar *b){
 	uchar tmp = *a;
@@ -202,6 +242,52 @@ uchar partition(uchar *arr, uchar start, uchar len, const uchar *adjrow){
 	return i;
 }
 
+// One bidomain at level 0 for each vertex label found in both graphs,
+// vertices with loops having labels of their own.
+void initial_domains(uchar domains[][BDS], uint *bd_pos, uchar *left, uchar *right){
+	for(uchar i = 0; i < n0; i++) left[i] = i;
+	for(uchar i = 0; i < n1; i++) right[i] = i;
+	INSERTION_SORT(uchar, left, n0, label0[left[j-1]] > label0[left[j]])
+	INSERTION_SORT(uchar, right, n1, label1[right[j-1]] > label1[right[j]])
+	for(uchar l = 0, r = 0; l < n0 && r < n1; ){
+		uint label = label0[left[l]];
+		if(label < label1[right[r]]) l++;
+		else if(label > label1[right[r]]) r++;
+		else {
+			uchar start_l = l, start_r = r;
+			while(l < n0 && label0[left[l]] == label) l++;
+			while(r < n1 && label1[right[r]] == label) r++;
+			add_bidomain(domains, bd_pos, start_l, start_r, l - start_l, r - start_r, 0, 0);
+		}
+	}
+}
+
+// Splits the l_len vertices at left[l] and the r_len at right[r], all
+// adjacent to v and w, by the label of the edge and, in directed graphs, its
+// direction: both sides are sorted by adjacency value and every value found
+// on both sides makes a bidomain. Returns the sum of their bounds.
+uint add_domains_by_edge_label(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right, uchar l, uchar r, uchar l_len, uchar r_len, uchar v, uchar w){
+	uchar *vv0 = left + l, *vv1 = right + r, *adjrow0 = adjmat0[v], *adjrow1 = adjmat1[w];
+	INSERTION_SORT(uchar, vv0, l_len, adjrow0[vv0[j-1]] > adjrow0[vv0[j]])
+	INSERTION_SORT(uchar, vv1, r_len, adjrow1[vv1[j-1]] > adjrow1[vv1[j]])
+	uint bound = 0;
+	uchar i = 0, j = 0;
+	while(i < l_len && j < r_len){
+		uchar label = adjrow0[vv0[i]];
+		if(label < adjrow1[vv1[j]]) i++;
+		else if(label > adjrow1[vv1[j]]) j++;
+		else {
+			uchar start_i = i, start_j = j;
+			while(i < l_len && adjrow0[vv0[i]] == label) i++;
+			while(j < r_len && adjrow1[vv1[j]] == label) j++;
+			add_bidomain(domains, bd_pos, l + start_i, r + start_j, i - start_i, j - start_j, true, (uchar)(cur_pos));
+			uint len = MIN(i - start_i, j - start_j);
+			bound += len;
+		}
+	}
+	return bound;
+}
+
 void generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right, uchar v, uchar w, uint inc_pos){
 	int i;
 	uint bd_backup = *bd_pos;
@@ -216,7 +302,9 @@ void generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uch
 			add_bidomain(domains, bd_pos, bd[L] + l_len, bd[R] + r_len, bd[LL] - l_len, bd[RL]  - r_len, bd[ADJ], (uchar)(cur_pos));
 			bound += MIN(bd[LL] - l_len, bd[RL]  - r_len);
 		}
-		if(l_len && r_len){
+		if(l_len && r_len && (arguments.labelled || arguments.directed)){
+			bound += add_domains_by_edge_label(domains, bd_pos, cur_pos, left, right, bd[L], bd[R], l_len, r_len, v, w);
+		} else if(l_len && r_len){
 			add_bidomain(domains, bd_pos, bd[L], bd[R], l_len, r_len, true, (uchar)(cur_pos));
 			bound += MIN(l_len, r_len);
 		}
@@ -238,6 +326,26 @@ uchar select_next_v(uchar *left, uchar *bd){
 	bd[RL]--;
 	return min;
 }
+// Once v has been left unmatched, its twins in the same domain can be left
+// unmatched too: any mapping using one of them is mirrored by a mapping using v.
+void remove_left_twins(uchar *left, uchar *bd, uchar v){
+	for (int i = bd[LL] - 1; i >= 0; i--)
+		if (twin0[left[bd[L] + i]] == twin0[v]) {
+			uchar_swap(&left[bd[L] + i], &left[bd[L] + bd[LL] - 1]);
+			bd[LL]--;
+		}
+}
+
+// True if a twin of w with a smaller index is still in the right domain:
+// w's are tried in increasing order, so that twin already covered this branch.
+bool twin_already_tried(uchar *right, uchar *bd, uchar w){
+	if (twin1[w] == w) return false;
+	for (uchar i = 0; i < bd[RL]; i++)
+		if (right[bd[R] + i] < w && twin1[right[bd[R] + i]] == twin1[w])
+			return true;
+	return false;
+}
+
 uchar find_min_value(uchar *arr, uchar start_idx, uchar len){
 	uchar min_v = UCHAR_MAX;
     for(int i = 0; i < len; i++){
@@ -277,6 +385,42 @@ void select_bidomain(uchar domains[][BDS], uint bd_pos,  uchar *left, int curren
 	}
 }
 
+// Canonical encoding of the bidomains of level cur_pos, used as nogood cache
+// key: each domain becomes its sorted left and right slices, and domains are
+// listed by increasing smallest left vertex. Returns the length of the key.
+uint encode_domains(uchar domains[][BDS], uint bd_pos, uint cur_pos, uchar *left, uchar *right, uchar *key){
+	bool connected = arguments.connected && cur_pos > 0;
+	uint domain_of[n0];
+	uint k = 0, n_bd = 0;
+	int i;
+	for (i = 0; i < n0; i++) domain_of[i] = UINT_MAX;
+	for (i = bd_pos - 1; i >= 0 && domains[i][P] == cur_pos; i--, n_bd++)
+		for (uchar j = 0; j < domains[i][LL]; j++)
+			domain_of[left[domains[i][L] + j]] = i;
+	key[k++] = n_bd;
+	key[k++] = connected;
+	for (uchar v = 0; v < n0; v++) {
+		if (domain_of[v] == UINT_MAX) continue;
+		uchar *bd = domains[domain_of[v]];
+		key[k++] = bd[LL];
+		key[k++] = bd[RL];
+		key[k++] = connected && bd[ADJ];
+		uchar *slice = &key[k];
+		for (uchar j = 0; j < bd[LL]; j++) {
+			slice[j] = left[bd[L] + j];
+			domain_of[slice[j]] = UINT_MAX;
+		}
+		INSERTION_SORT(uchar, slice, bd[LL], (slice[j-1] > slice[j]))
+		k += bd[LL];
+		slice = &key[k];
+		for (uchar j = 0; j < bd[RL]; j++)
+			slice[j] = right[bd[R] + j];
+		INSERTION_SORT(uchar, slice, bd[RL], (slice[j-1] > slice[j]))
+		k += bd[RL];
+	}
+	return k;
+}
+
 double compute_elapsed_sec(){
 	struct timespec now;
 	double time_elapsed;
@@ -310,19 +454,31 @@ void mcs(uchar incumbent[][2], uint *inc_pos){
 	uchar left[n0], right[n1];
 	uchar v, w, *bd;
 	uint bd_pos = 0;
-	for(uchar i = 0; i < n0; i++) left[i] = i;
-	for(uchar i = 0; i < n1; i++) right[i] = i;
-	add_bidomain(domains, &bd_pos, 0, 0, n0, n1, 0, 0);
+	initial_domains(domains, &bd_pos, left, right);
+
+	// key of every open level of the search, stored once the level is closed
+	uint key_size = 2 + 3*min + n0 + n1, key_len[min + 1], bound;
+	uchar *level_key = NULL;
+	if (nogood != NULL) {
+		level_key = malloc((min + 1) * key_size);
+		for (uint p = 0; p <= min; p++) key_len[p] = 0;
+	}
 
 	while (bd_pos > 0) {
 		if (arguments.timeout && compute_elapsed_sec() > arguments.timeout) {
         	arguments.timeout = -1;
-        	return;
+        	break;
    		}
+		if (target && *inc_pos >= target)
+			break;
 		
 		bd = &domains[bd_pos - 1][L];
-		if (calc_bound(domains, bd_pos, bd[P]) + bd[P] <= *inc_pos || (bd[LL] == 0 && bd[RL] == bd[IRL])) {
+		if (calc_bound(domains, bd_pos, bd[P]) + bd[P] + (bd[RL] != bd[IRL]) <= *inc_pos || (bd[LL] == 0 && bd[RL] == bd[IRL])) {
 			bd_pos--;
+			if (level_key != NULL && key_len[bd[P]] && (bd_pos == 0 || domains[bd_pos - 1][P] < bd[P])) {
+				nogood_store(nogood, &level_key[bd[P] * key_size], key_len[bd[P]], *inc_pos - bd[P]);
+				key_len[bd[P]] = 0;
+			}
 		} else {
 			select_bidomain(domains, bd_pos, left, domains[bd_pos - 1][P], arguments.connected);
 			v = select_next_v(left, bd);
@@ -331,13 +487,66 @@ void mcs(uchar incumbent[][2], uint *inc_pos){
 				right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
 				right[bd[R] + bd[RL]] = w;
 				bd[W] = w;                      // store the W used for this iteration
+				if (twin_already_tried(right, bd, w))
+					continue;
 				cur[bd[P]][L] = v;
 				cur[bd[P]][R] = w;
 				update_incumbent(cur, incumbent, bd[P] + (uchar) 1, inc_pos);
-				generate_next_domains(domains, &bd_pos, bd[P] + 1, left, right, v, w, *inc_pos);
-			}
+				uint bd_backup = bd_pos, p = bd[P] + 1;
+				generate_next_domains(domains, &bd_pos, p, left, right, v, w, *inc_pos);
+				if (level_key != NULL && bd_pos > bd_backup) {
+					key_len[p] = encode_domains(domains, bd_pos, p, left, right, &level_key[p * key_size]);
+					if (nogood_lookup(nogood, &level_key[p * key_size], key_len[p], &bound) && p + bound <= *inc_pos) {
+						bd_pos = bd_backup;
+						key_len[p] = 0;
+					}
+				}
+			} else
+				remove_left_twins(left, bd, v);
 		}
 	}
+	free(level_key);
+}
+
+// Decision version of mcs: is there a solution of size goal = min(n0,n1)-k?
+// The incumbent starts at goal-1, so the bound prunes aggressively from the
+// root, and the first goal reached is the optimum. Goals below the threshold
+// are not tried.
+void mcs_k_down(uchar incumbent[][2], uint *inc_pos, uint threshold){
+	uint min = MIN(n0, n1);
+	if (threshold > min) {
+		if (!arguments.quiet) printf("root bound %d below threshold\n", min);
+		return;
+	}
+	uint floor = threshold > 0 ? threshold : 1;
+	for (uint goal = min; goal >= floor; goal--) {
+		*inc_pos = goal - 1;
+		target = goal;
+		mcs(incumbent, inc_pos);
+		if (*inc_pos == goal)
+			break;
+		*inc_pos = 0;	// goal-1 was only a bound, there is no mapping of that size yet
+		if (arguments.timeout == -1)
+			break;
+		if (arguments.verbose) printf("No solution of size %d\n", goal);
+	}
+	target = 0;
+}
+
+// Threshold version of mcs: a single k-down step with goal = threshold. The
+// root bound is min(n0,n1), so a threshold above it fails without searching.
+void mcs_at_least(uchar incumbent[][2], uint *inc_pos, uint threshold){
+	uint min = MIN(n0, n1);
+	if (threshold > min) {
+		if (!arguments.quiet) printf("root bound %d below threshold\n", min);
+		return;
+	}
+	*inc_pos = threshold - 1;
+	target = threshold;
+	mcs(incumbent, inc_pos);
+	if (*inc_pos < threshold)
+		*inc_pos = 0;	// threshold-1 was only a bound
+	target = 0;
 }
 
 int main(int argc, char** argv){
@@ -349,9 +558,11 @@ int main(int argc, char** argv){
 
 	char format = arguments.lad ? 'L' : 'B';
 	graph_t *g0 = calloc(1, sizeof *g0 );
-	readGraph(arguments.filename1, g0, format);
+	readGraph(arguments.filename1, g0, format, arguments.directed, arguments.labelled);
 	graph_t *g1 = calloc(1, sizeof *g1 );
-	readGraph(arguments.filename2, g1, format);
+	readGraph(arguments.filename2, g1, format, arguments.directed, arguments.labelled);
+	if (format != 'L')
+		printf("%d vertices\n%d vertices\n", g0->n, g1->n);
 	g0 = sort_vertices_by_degree(g0, (graph_edge_count(g1) > g1->n*(g1->n-1)/2));
 	g1 = sort_vertices_by_degree(g1, (graph_edge_count(g0) > g0->n*(g0->n-1)/2));
 
@@ -360,14 +571,35 @@ int main(int argc, char** argv){
 
 	n0 = g0->n;
 	n1 = g1->n;
+	twin0 = g0->twin;
+	twin1 = g1->twin;
+	label0 = g0->label;
+	label1 = g1->label;
 	uint min_size = MIN(n0, n1);
 	uchar solution[min_size][2];
 
-	uint sol_len = 0;
+	uint sol_len = 0, threshold = arguments.at_least;
+	if (arguments.ratio > 0) {
+		double k = arguments.ratio * min_size;
+		threshold = (uint)k + ((uint)k < k);
+	}
+	if (arguments.nogood_mb > 0)
+		nogood = nogood_init(arguments.nogood_mb, 2 + 3*min_size + n0 + n1);
 	clock_gettime(CLOCK_MONOTONIC, &start);
-	mcs(solution, &sol_len);
+	if (arguments.k_down)
+		mcs_k_down(solution, &sol_len, threshold);
+	else if (threshold)
+		mcs_at_least(solution, &sol_len, threshold);
+	else
+		mcs(solution, &sol_len);
 	clock_gettime(CLOCK_MONOTONIC, &finish);
 
+	if (nogood != NULL) {
+		if (arguments.verbose)
+			printf("nogood cache: %u slots, %llu stores, %llu hits\n", nogood->n_slots, nogood->stores, nogood->hits);
+		nogood_free(nogood);
+	}
+
 
 	
 
@@ -377,6 +609,8 @@ int main(int argc, char** argv){
 	
 	if (arguments.timeout == -1){
         printf("TIMEOUT\n");
+	} else if (threshold) {
+		printf("Threshold %d %s\n", threshold, sol_len >= threshold ? "reached" : "not reachable");
 	}
 	
 	printf("SOLUTION size:%d\nsol: ", sol_len);
@@ -0,0 +1,46 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef NOGOOD_H_
+#define NOGOOD_H_
+
+#include <stdbool.h>
+
+// Direct-mapped table of failed subproblems. Each slot stores the canonical
+// encoding of a set of live bidomains together with the largest number of
+// pairs that can still be added to a mapping reaching that configuration.
+// A colliding store simply overwrites the slot, so memory stays bounded.
+typedef struct nogood_cache_s {
+    unsigned int n_slots;
+    unsigned int key_size;
+    unsigned char *keys;
+    unsigned int *key_len;
+    unsigned int *bound;
+    unsigned long long hits;
+    unsigned long long stores;
+}nogood_cache_t;
+
+nogood_cache_t *nogood_init(unsigned int megabytes, unsigned int key_size);
+
+bool nogood_lookup(nogood_cache_t *cache, const void *key, unsigned int len, unsigned int *bound);
+
+void nogood_store(nogood_cache_t *cache, const void *key, unsigned int len, unsigned int bound);
+
+void nogood_free(nogood_cache_t *cache);
+
+#endif /* NOGOOD_H_ */
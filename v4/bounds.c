@@ -0,0 +1,167 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "bounds.h"
+
+static int by_value(const void *a, const void *b) {
+    uint x = *(const uint *) a, y = *(const uint *) b;
+    return (x > y) - (x < y);
+}
+
+// Vertices can only be matched to vertices of the same label, so a common
+// subgraph has at most the smaller count of each label.
+static uint label_bound(graph_t *g0, graph_t *g1) {
+    uint *l0 = malloc((g0->n + 1) * sizeof *l0), *l1 = malloc((g1->n + 1) * sizeof *l1);
+    memcpy(l0, g0->label, g0->n * sizeof *l0);
+    memcpy(l1, g1->label, g1->n * sizeof *l1);
+    qsort(l0, g0->n, sizeof *l0, by_value);
+    qsort(l1, g1->n, sizeof *l1, by_value);
+    uint bound = 0;
+    for (int i = 0, j = 0; i < g0->n && j < g1->n; )
+        if (l0[i] < l1[j]) i++;
+        else if (l0[i] > l1[j]) j++;
+        else { bound++; i++; j++; }
+    free(l0);
+    free(l1);
+    return bound;
+}
+
+// sum[k] is the sum over the first k of deg, each capped at k-1
+static void capped_sums(const uint *deg, int n, unsigned long long *sum) {
+    unsigned long long *prefix = malloc((n + 1) * sizeof *prefix);
+    int *at_least = calloc(n + 1, sizeof *at_least);   // at_least[t] vertices of degree >= t
+    prefix[0] = 0;
+    for (int i = 0; i < n; i++) {
+        prefix[i + 1] = prefix[i] + deg[i];
+        at_least[deg[i] < (uint) n ? deg[i] : (uint) n]++;
+    }
+    for (int t = n - 1; t >= 0; t--)
+        at_least[t] += at_least[t + 1];
+    sum[0] = 0;
+    for (int k = 1; k <= n; k++) {
+        int j = MIN(k, at_least[k - 1]);
+        sum[k] = (unsigned long long) j * (k - 1) + prefix[k] - prefix[j];
+    }
+    free(prefix);
+    free(at_least);
+}
+
+uint degree_bound(const uint *deg0, int n0, const uint *deg1, int n1, bool connected) {
+    int min = MIN(n0, n1);
+    const uint *deg[2] = { deg0, deg1 };
+    int n[2] = { n0, n1 };
+    unsigned long long *edges[2], *non_edges[2];
+    int non_isolated = min;
+    for (int g = 0; g < 2; g++) {
+        uint *co = malloc((n[g] + 1) * sizeof *co);
+        int nz = 0;
+        for (int i = 0; i < n[g]; i++) {
+            co[i] = n[g] - 1 - deg[g][n[g] - 1 - i];
+            nz += deg[g][i] > 0;
+        }
+        non_isolated = MIN(non_isolated, nz);
+        edges[g] = malloc((n[g] + 1) * sizeof *edges[g]);
+        non_edges[g] = malloc((n[g] + 1) * sizeof *non_edges[g]);
+        capped_sums(deg[g], n[g], edges[g]);
+        capped_sums(co, n[g], non_edges[g]);
+        free(co);
+    }
+    int k = min;
+    for (; k > 1; k--) {
+        unsigned long long e = MIN(edges[0][k], edges[1][k]);
+        unsigned long long ne = MIN(non_edges[0][k], non_edges[1][k]);
+        if ((unsigned long long) k * (k - 1) <= e + ne)
+            break;
+    }
+    // a connected subgraph of two or more vertices has no isolated vertex
+    if (connected && k > 1 && non_isolated < k)
+        k = non_isolated > 1 ? non_isolated : 1;
+    for (int g = 0; g < 2; g++) {
+        free(edges[g]);
+        free(non_edges[g]);
+    }
+    return k;
+}
+
+static bool consistent(graph_t *g0, graph_t *g1, const int *map0, const int *map1, int k, int v, int w, bool connected) {
+    bool attached = k == 0;
+    for (int i = 0; i < k; i++) {
+        if (g0->adjmat[v][map0[i]] != g1->adjmat[w][map1[i]])
+            return false;
+        attached = attached || g0->adjmat[v][map0[i]];
+    }
+    return !connected || attached;
+}
+
+// Maps the vertices of g0, by decreasing degree, to the first vertex of g1,
+// by decreasing degree, that keeps the mapping a common subgraph. For the
+// connected version the passes are repeated while they add vertices.
+static uint greedy_lower(graph_t *g0, graph_t *g1, bool connected) {
+    int *order0 = degree_order(g0, false), *order1 = degree_order(g1, false);
+    int *map0 = malloc((g0->n + 1) * sizeof *map0), *map1 = malloc((g1->n + 1) * sizeof *map1);
+    bool *used0 = calloc(g0->n + 1, sizeof *used0), *used1 = calloc(g1->n + 1, sizeof *used1);
+    int k = 0;
+    for (bool added = true; added; ) {
+        added = false;
+        for (int i = 0; i < g0->n; i++) {
+            int v = order0[i];
+            if (used0[v]) continue;
+            for (int j = 0; j < g1->n; j++) {
+                int w = order1[j];
+                if (!used1[w] && g0->label[v] == g1->label[w] && consistent(g0, g1, map0, map1, k, v, w, connected)) {
+                    map0[k] = v;
+                    map1[k++] = w;
+                    used0[v] = used1[w] = added = true;
+                    break;
+                }
+            }
+        }
+        if (!connected) break;
+    }
+    free(order0);
+    free(order1);
+    free(map0);
+    free(map1);
+    free(used0);
+    free(used1);
+    return k;
+}
+
+void compute_bounds(graph_t *g0, graph_t *g1, bool connected, mcs_bounds_t *b) {
+    uint *deg[2];
+    graph_t *g[2] = { g0, g1 };
+    for (int k = 0; k < 2; k++) {
+        int n = g[k]->n;
+        int *count = calloc(n + 1, sizeof *count);   // degrees are below n: counting sort
+        for (int v = 0; v < n; v++)
+            count[g[k]->degree[v]]++;
+        deg[k] = malloc((n + 1) * sizeof *deg[k]);
+        for (int d = n, i = 0; d >= 0; d--)
+            while (count[d]-- > 0)
+                deg[k][i++] = d;
+        free(count);
+    }
+    b->size_bound = MIN(g0->n, g1->n);
+    b->label_bound = label_bound(g0, g1);
+    b->degree_bound = degree_bound(deg[0], g0->n, deg[1], g1->n, connected);
+    b->upper = MIN(b->size_bound, b->label_bound);
+    b->upper = MIN(b->upper, b->degree_bound);
+    b->lower = greedy_lower(g0, g1, connected);
+    free(deg[0]);
+    free(deg[1]);
+}
@@ -0,0 +1,35 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef TRIMBLE_IT_MULTI_BOUNDS_H
+#define TRIMBLE_IT_MULTI_BOUNDS_H
+
+#include "utils.h"
+#include "mcs.h"
+
+// Precondition: g0->degree and g1->degree are computed
+void compute_bounds(graph_t *g0, graph_t *g1, bool connected, mcs_bounds_t *b);
+
+// The common subgraph of k vertices has e edges and k(k-1)/2 - e non-edges,
+// and in each graph the edges, or the non-edges, of k vertices cannot be more
+// than the k largest degrees, or co-degrees, allow. The largest k for which
+// both graphs allow enough is a bound.
+// Precondition: deg0 and deg1 are non-increasing
+uint degree_bound(const uint *deg0, int n0, const uint *deg1, int n1, bool connected);
+
+#endif //TRIMBLE_IT_MULTI_BOUNDS_H
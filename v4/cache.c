@@ -0,0 +1,128 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "cache.h"
+
+static cache_entry_t **bucket_of(cache_t *c, unsigned long long h0, unsigned long long h1, bool connected) {
+    return &c->buckets[(h0 ^ (h1 * 0x9E3779B97F4A7C15ULL) ^ connected) % CACHE_BUCKETS];
+}
+
+static cache_entry_t *find(cache_t *c, unsigned long long h0, unsigned long long h1, bool connected) {
+    cache_entry_t *e = *bucket_of(c, h0, h1, connected);
+    while (e != NULL && (e->h0 != h0 || e->h1 != h1 || e->connected != connected))
+        e = e->next;
+    return e;
+}
+
+// Keeps the largest known subgraph and the smallest bound in *merged; returns
+// whether the entry is new or any of lower, bound and map changed
+static bool merge(cache_t *c, const cache_entry_t *e, cache_entry_t **merged) {
+    cache_entry_t *old = find(c, e->h0, e->h1, e->connected);
+    if (old == NULL) {
+        old = malloc(sizeof *old);
+        *old = *e;
+        cache_entry_t **bucket = bucket_of(c, e->h0, e->h1, e->connected);
+        old->next = *bucket;
+        *bucket = old;
+        *merged = old;
+        return true;
+    }
+    bool changed = false;
+    if (e->lower > old->lower) {
+        old->lower = e->lower;
+        memcpy(old->map, e->map, e->lower * sizeof *e->map);
+        changed = true;
+    }
+    if (e->bound >= 0 && (old->bound < 0 || e->bound < old->bound)) {
+        old->bound = e->bound;
+        changed = true;
+    }
+    *merged = old;
+    return changed;
+}
+
+static bool parse_entry(char *line, cache_entry_t *e) {
+    int connected, len;
+    if (sscanf(line, "%llx %llx %d %d %d%n", &e->h0, &e->h1, &connected, &e->lower, &e->bound, &len) != 5
+            || e->lower < 0 || e->lower > MAX_GRAPH_SIZE)
+        return false;
+    e->connected = connected;
+    char *p = line + len;
+    for (int i = 0; i < e->lower; i++) {
+        unsigned int v, w;
+        int used;
+        if (sscanf(p, " %u:%u%n", &v, &w, &used) != 2 || v >= MAX_GRAPH_SIZE || w >= MAX_GRAPH_SIZE)
+            return false;
+        e->map[i][L] = v;
+        e->map[i][R] = w;
+        p += used;
+    }
+    return true;
+}
+
+cache_t *cache_open(const char *filename) {
+    FILE *f = fopen(filename, "a+");
+    if (f == NULL) return NULL;
+    cache_t *c = calloc(1, sizeof *c);
+    c->f = f;
+    pthread_mutex_init(&c->mtx, NULL);
+    char *line = NULL;
+    size_t size = 0;
+    cache_entry_t e, *m;
+    rewind(f);
+    while (getline(&line, &size, f) != -1)
+        if (parse_entry(line, &e))      // lines cut short by a crash are skipped
+            merge(c, &e, &m);
+    free(line);
+    return c;
+}
+
+bool cache_lookup(cache_t *c, unsigned long long h0, unsigned long long h1, bool connected, cache_entry_t *e) {
+    pthread_mutex_lock(&c->mtx);
+    cache_entry_t *found = find(c, h0, h1, connected);
+    if (found != NULL) *e = *found;
+    pthread_mutex_unlock(&c->mtx);
+    return found != NULL;
+}
+
+void cache_store(cache_t *c, const cache_entry_t *e) {
+    pthread_mutex_lock(&c->mtx);
+    cache_entry_t *m;
+    if (!merge(c, e, &m)) {             // nothing new to log
+        pthread_mutex_unlock(&c->mtx);
+        return;
+    }
+    fprintf(c->f, "%016llx %016llx %d %d %d", m->h0, m->h1, m->connected, m->lower, m->bound);
+    for (int i = 0; i < m->lower; i++)
+        fprintf(c->f, " %u:%u", m->map[i][L], m->map[i][R]);
+    fprintf(c->f, "\n");
+    fflush(c->f);
+    pthread_mutex_unlock(&c->mtx);
+}
+
+void cache_close(cache_t *c) {
+    for (int i = 0; i < CACHE_BUCKETS; i++)
+        while (c->buckets[i] != NULL) {
+            cache_entry_t *e = c->buckets[i];
+            c->buckets[i] = e->next;
+            free(e);
+        }
+    fclose(c->f);
+    pthread_mutex_destroy(&c->mtx);
+    free(c);
+}
@@ -0,0 +1,54 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef TRIMBLE_IT_MULTI_CACHE_H
+#define TRIMBLE_IT_MULTI_CACHE_H
+
+#include "utils.h"
+
+#define CACHE_BUCKETS 4096
+
+// What is known about a pair of graphs, in their canonical numbering (see
+// canonical_form): a common subgraph of lower vertices, given by map, and
+// that none has more than bound vertices, -1 if there is no such proof yet.
+typedef struct cache_entry_s {
+    unsigned long long h0, h1;
+    bool connected;
+    int lower, bound;
+    uchar map[MAX_GRAPH_SIZE][2];
+    struct cache_entry_s *next;
+} cache_entry_t;
+
+// The file is a log of entries, one per line; the entries of the same pair
+// are merged on load, and a store appends the merged entry only when it adds
+// a larger subgraph or a smaller bound.
+typedef struct mcs_cache_s {
+    FILE *f;
+    pthread_mutex_t mtx;
+    cache_entry_t *buckets[CACHE_BUCKETS];
+} cache_t;
+
+cache_t *cache_open(const char *filename);
+
+bool cache_lookup(cache_t *c, unsigned long long h0, unsigned long long h1, bool connected, cache_entry_t *e);
+
+void cache_store(cache_t *c, const cache_entry_t *e);
+
+void cache_close(cache_t *c);
+
+#endif //TRIMBLE_IT_MULTI_CACHE_H
@@ -0,0 +1,169 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+// mcs_convert: writes graphs in the binary or LAD format as .mcsg files,
+// which mcs_graph_read, and so every mode of the solver, maps with no
+// preprocessing, or packs them into a database, named by file name.
+
+#define _GNU_SOURCE
+
+#include <argp.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcs.h"
+
+#define OPT_DIRECTED 256           // -i is --list
+
+static struct argp_option options[] = { { "quiet", 'q', 0, 0, "Quiet output" },
+                                        { "lad", 'l', 0, 0, "Read LAD format" },
+                                        { "labelled", 'L', 0, 0, "Keep the vertex and edge labels of binary files" },
+                                        { "dir", 'd', "DIR", 0, "Write the .mcsg files to DIR instead of next to the inputs" },
+                                        { "pack", 'p', "DB", 0, "Pack the graphs into the database DB instead, named by their file names" },
+                                        { "directed", OPT_DIRECTED, 0, 0, "Read the graphs as directed" },
+                                        { "list", 'i', "DB", 0, "List the graphs of the database DB: ID NAME VERTICES EDGES" },
+                                        { 0 }
+};
+
+static char doc[] = "Convert graphs to the .mcsg format, FILENAME to FILENAME.mcsg";
+static char args_doc[] = "FILENAME...\n--pack=DB FILENAME...\n--list=DB";
+static struct {
+    bool quiet;
+    bool lad;
+    bool labelled;
+    bool directed;
+    char *dir;
+    char *pack;
+    char *list;
+    char **filenames;
+    int n_files;
+} arguments;
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state) {
+    switch (key) {
+        case 'q':
+            arguments.quiet = true;
+            break;
+        case 'l':
+            arguments.lad = true;
+            break;
+        case 'L':
+            arguments.labelled = true;
+            break;
+        case OPT_DIRECTED:
+            arguments.directed = true;
+            break;
+        case 'd':
+            arguments.dir = arg;
+            break;
+        case 'p':
+            arguments.pack = arg;
+            break;
+        case 'i':
+            arguments.list = arg;
+            break;
+        case ARGP_KEY_ARG:
+            arguments.filenames = &state->argv[state->next - 1];
+            arguments.n_files = state->argc - state->next + 1;
+            state->next = state->argc;
+            break;
+        case ARGP_KEY_END:
+            if (arguments.list != NULL ? arguments.n_files != 0 : arguments.n_files == 0)
+                argp_usage(state);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+static mcs_graph_t *read_graph(const char *filename) {
+    int flags = (arguments.directed ? MCS_GRAPH_DIRECTED : 0) | (arguments.labelled ? MCS_GRAPH_LABELLED : 0);
+    return mcs_graph_read(filename, arguments.lad ? 'L' : 'B', flags);
+}
+
+static int list() {
+    mcs_db_t *db = mcs_db_open(arguments.list);
+    if (db == NULL) {
+        printf("Cannot open database\n");
+        return 1;
+    }
+    mcs_db_entry_t e;
+    for (int i = 0; i < mcs_db_size(db); i++) {
+        mcs_db_entry(db, i, &e);
+        printf("%d %s %d %d\n", i, e.name, e.n, e.m);
+    }
+    mcs_db_close(db);
+    return 0;
+}
+
+static int pack() {
+    mcs_graph_t **graphs = malloc(arguments.n_files * sizeof *graphs);
+    const char **names = malloc(arguments.n_files * sizeof *names);
+    int n = 0, failed = 0;
+    for (int i = 0; i < arguments.n_files; i++) {
+        char *in = arguments.filenames[i];
+        if ((graphs[n] = read_graph(in)) == NULL) {
+            printf("Cannot read %s\n", in);
+            failed++;
+            continue;
+        }
+        names[n++] = basename(in);
+    }
+    if (mcs_db_write(arguments.pack, graphs, names, n) != 0) {
+        printf("Cannot write %s\n", arguments.pack);
+        failed++;
+    } else if (!arguments.quiet)
+        printf("%d graphs -> %s\n", n, arguments.pack);
+    for (int i = 0; i < n; i++)
+        mcs_graph_free(graphs[i]);
+    free(graphs);
+    free(names);
+    return failed > 0;
+}
+
+int main(int argc, char** argv) {
+    argp_parse(&argp, argc, argv, 0, 0, 0);
+    if (arguments.list != NULL)
+        return list();
+    if (arguments.pack != NULL)
+        return pack();
+    int failed = 0;
+    for (int i = 0; i < arguments.n_files; i++) {
+        char *in = arguments.filenames[i], *out;
+        if (arguments.dir != NULL) {
+            char *copy = strdup(in);
+            if (asprintf(&out, "%s/%s.mcsg", arguments.dir, basename(copy)) < 0) out = NULL;
+            free(copy);
+        } else if (asprintf(&out, "%s.mcsg", in) < 0)
+            out = NULL;
+        mcs_graph_t *g = read_graph(in);
+        if (g == NULL || out == NULL || mcs_graph_write(g, out) != 0) {
+            printf("Cannot convert %s\n", in);
+            failed++;
+        } else if (!arguments.quiet)
+            printf("%s -> %s (%d vertices)\n", in, out, mcs_graph_size(g));
+        if (g != NULL) mcs_graph_free(g);
+        free(out);
+    }
+    return failed > 0;
+}
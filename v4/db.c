@@ -0,0 +1,103 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "db.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint32_t name_hash(const char *name) {
+    uint32_t h = 2166136261u;      // FNV-1a
+    for (const char *c = name; *c; c++)
+        h = (h ^ (unsigned char) *c) * 16777619u;
+    return h;
+}
+
+// Checks that the index and the names lie in the file, so that the lookups
+// never read outside of it; the images are checked when they are used.
+static bool valid(const db_t *db) {
+    const db_header_t *h = db->map;
+    if (db->size < sizeof *h || memcmp(h->magic, DB_MAGIC, sizeof h->magic) != 0 || h->version != DB_VERSION)
+        return false;
+    size_t names_end = sizeof *h + (size_t) h->count * sizeof(db_entry_t) + h->names_size;
+    if (h->count > INT_MAX || names_end > db->size || (h->count > 0 && (h->names_size == 0 || db->names[h->names_size - 1] != '\0')))
+        return false;
+    for (uint32_t i = 0; i < h->count; i++) {
+        const db_entry_t *e = &db->entries[i];
+        if (e->name >= h->names_size || e->offset % 8 != 0 || e->offset < names_end
+                || e->offset > db->size || e->size > db->size - e->offset)
+            return false;
+    }
+    return true;
+}
+
+db_t *db_open(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    db_t *db = calloc(1, sizeof *db);
+    db->size = st.st_size;
+    db->map = mmap(NULL, db->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (db->map == MAP_FAILED) {
+        free(db);
+        return NULL;
+    }
+    const db_header_t *h = db->map;
+    db->entries = (const db_entry_t *) (h + 1);
+    db->names = (const char *) (db->entries + h->count);
+    if (!valid(db)) {
+        munmap(db->map, db->size);
+        free(db);
+        return NULL;
+    }
+    db->count = h->count;
+
+    uint32_t slots = 2;
+    while (slots < 2 * (uint32_t) db->count) slots *= 2;
+    db->table = malloc(slots * sizeof *db->table);
+    db->table_mask = slots - 1;
+    for (uint32_t i = 0; i < slots; i++)
+        db->table[i] = -1;
+    for (int id = 0; id < db->count; id++) {
+        uint32_t i = name_hash(db->names + db->entries[id].name) & db->table_mask;
+        while (db->table[i] != -1)
+            i = (i + 1) & db->table_mask;
+        db->table[i] = id;
+    }
+    return db;
+}
+
+int db_find(const db_t *db, const char *name) {
+    int found = -1;
+    for (uint32_t i = name_hash(name) & db->table_mask; db->table[i] != -1; i = (i + 1) & db->table_mask)
+        if (strcmp(db->names + db->entries[db->table[i]].name, name) == 0
+                && (found == -1 || db->table[i] < found))
+            found = db->table[i];
+    return found;
+}
+
+void db_close(db_t *db) {
+    munmap(db->map, db->size);
+    free(db->table);
+    free(db);
+}
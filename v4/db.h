@@ -0,0 +1,72 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef TRIMBLE_IT_MULTI_DB_H
+#define TRIMBLE_IT_MULTI_DB_H
+
+#include "utils.h"
+#include "mcs.h"
+
+#include <stdint.h>
+
+#define DB_MAGIC "MCSD"
+#define DB_VERSION 1
+
+// A database file is
+//
+//   header        magic, version, number of graphs and size of the names
+//   entries       one per graph, the index
+//   names         NUL terminated, in the order of the graphs
+//   images        the .mcsg image of each graph, at offsets multiple of 8
+//
+// in the byte order of the machine that wrote it.
+typedef struct db_header_s {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t names_size;
+} db_header_t;
+
+typedef struct db_entry_s {
+    uint64_t offset;                // of the image, from the start of the file
+    uint64_t size;
+    uint32_t name;                  // offset in the names
+    uint32_t n, m;
+    uint32_t labels[MCS_DB_LABELS];
+    uint32_t pad;
+} db_entry_t;
+
+// The file is mapped once; names are found through an open addressing table
+typedef struct mcs_db_s {
+    void *map;
+    size_t size;
+    const db_entry_t *entries;
+    const char *names;
+    int count;
+    int *table;                     // ids, -1 for an empty slot
+    uint32_t table_mask;
+} db_t;
+
+db_t *db_open(const char *filename);
+
+// Id of the first graph called name, -1 if there is none
+int db_find(const db_t *db, const char *name);
+
+void db_close(db_t *db);
+
+#endif //TRIMBLE_IT_MULTI_DB_H
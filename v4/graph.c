@@ -23,119 +23,273 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-static void fail(char* msg) {
-    printf("%s\n", msg);
-    exit(1);
-}
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 unsigned int* calculate_degrees(graph_t *g) {
-	short int size = g->n;
-	unsigned int *degree = calloc(size, sizeof *degree);
+	unsigned int *degree = calloc(g->n, sizeof *degree);
 	for (int v = 0; v < g->n; v++)
 		for (int w = 0; w < g->n; w++)
 			if (g->adjmat[v][w]) degree[v]++;
 	return degree;
 }
 
-void add_edge(graph_t *g, int v, int w) {
-    if (v != w) {
-        g->adjmat[v][w] = 1;
-        g->adjmat[w][v] = 1;
+static unsigned long long vertex_key(unsigned long long x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+static bool are_twins(graph_t *g, int u, int v) {
+	if (g->label[u] != g->label[v]) return false;
+	if (g->adjmat[u][v] != g->adjmat[v][u]) return false;   // an arc between them
+	for (int x = 0; x < g->n; x++)
+		if (x != u && x != v && g->adjmat[u][x] != g->adjmat[v][x])
+			return false;
+	return true;
+}
+
+// twin[v] is the smallest vertex u whose neighbourhood, apart from u and v
+// themselves, is the same as the one of v (true or false twins).
+// Swapping two twins is an automorphism of g, so the search only has to try
+// one vertex per twin class. Candidates are found by hashing the open and
+// closed neighbourhoods, so the pass is linear in the size of adjmat.
+unsigned int* calculate_twins(graph_t *g) {
+	unsigned int *twin = malloc(g->n * sizeof *twin);
+	unsigned long long *hash = calloc(g->n, sizeof *hash);
+	for (int v = 0; v < g->n; v++)
+		for (int w = 0; w < g->n; w++)
+			if (g->adjmat[v][w]) hash[v] += vertex_key(w);
+	for (int v = 0; v < g->n; v++) {
+		twin[v] = v;
+		for (int u = 0; u < v; u++) {
+			if (twin[u] != u) continue;
+			if (hash[u] != hash[v] && hash[u] + vertex_key(u) != hash[v] + vertex_key(v)) continue;
+			if (are_twins(g, u, v)) {
+				twin[v] = u;
+				break;
+			}
+		}
+	}
+	free(hash);
+	return twin;
+}
+
+// The adjacency matrix holds 1 + the label of each edge, 0 for no edge. In
+// a directed graph, adjmat[v][w] holds 1 + the label of the arc from v to w
+// in its low 4 bits and 1 + the label of the arc from w to v in its high 4
+// bits, so that refining by v splits the neighbours into out, in and both.
+void add_edge(graph_t *g, int v, int w, bool directed, unsigned int label) {
+    if (v != w && directed) {
+        g->adjmat[v][w] = (g->adjmat[v][w] & 0xf0) | (1 + label);
+        g->adjmat[w][v] = (g->adjmat[w][v] & 0x0f) | ((1 + label) << 4);
+    } else if (v != w) {
+        g->adjmat[v][w] = 1 + label;
+        g->adjmat[w][v] = 1 + label;
     } else {
-        // To indicate that a vertex has a loop, we set its label to 1
-        g->label[v] = 1;
+        // To indicate that a vertex has a loop, we set the top bit of its label
+        g->label[v] |= 1u << 31;
     }
 }
 
-unsigned int read_word(FILE *fp) {
-    unsigned char a[2];
-    if (fread(a, 1, 2, fp) != 2)
-        fail("Error reading file.\n");
-    return (unsigned int)a[0] | (((unsigned int)a[1]) << 8);
-}
-
-// Precondition: *g is already zeroed out
-// returns max edge label
-void readBinaryGraph(char* filename, graph_t* g) {
-    FILE* f;
-	int i;
-    if ((f=fopen(filename, "rb"))==NULL)
-        fail("Cannot open file");
-
-    unsigned int nvertices = read_word(f);
-    g->n = nvertices;
-    g->label = calloc(g->n, sizeof *g->label);
-    g->adjmat = calloc(g->n, sizeof *g->adjmat);
-    for(i = 0; i < g->n; i++)
-    	g->adjmat[i] = calloc(g->n, sizeof *g->adjmat[i]);
-    printf("%d vertices\n", nvertices);
-    
-    printf("paolo2");
-    for (int i=0; i<nvertices; i++) {
-        read_word(f);   // ignore label
+// The adjacency matrix is one block: the row pointers followed by the
+// n rows, so a graph costs two allocations whatever its size.
+void alloc_graph(graph_t *g, int n) {
+    g->n = n;
+    g->label = calloc(n, sizeof *g->label);
+    g->adjmat = calloc(1, n * sizeof *g->adjmat + (size_t) n * n);
+    unsigned char *rows = (unsigned char *) (g->adjmat + n);
+    for (int i = 0; i < n; i++)
+        g->adjmat[i] = rows + (size_t) i * n;
+}
+
+// Maps filename read-only, NULL and *size 0 for an empty file; -1 if the
+// file cannot be opened or mapped.
+static int map_file(char *filename, const unsigned char **map, size_t *size) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        fprintf(stderr, "%s: Cannot open file\n", filename);
+        return -1;
+    }
+    *size = st.st_size;
+    *map = NULL;
+    if (*size > 0) {
+        *map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*map == MAP_FAILED) {
+            close(fd);
+            fprintf(stderr, "%s: Cannot map file\n", filename);
+            return -1;
+        }
+        madvise((void *) *map, *size, MADV_SEQUENTIAL);
     }
+    close(fd);
+    return 0;
+}
 
-    for (int i=0; i<nvertices; i++) {
-        int len = read_word(f);
-        for (int j=0; j<len; j++) {
-            int target = read_word(f);
-            read_word(f); // ignore label
-            add_edge(g, i, target);
+static void unmap_file(const unsigned char *map, size_t size) {
+    if (map != NULL) munmap((void *) map, size);
+}
+
+// Completes g after a successful decoding; otherwise reports the error on
+// stderr and frees what the decoding allocated, leaving g zeroed out.
+static int read_result(graph_t *g, char *filename, int line, const char *error) {
+    if (error == NULL) {
+        g->degree = calculate_degrees(g);
+        return 0;
+    }
+    if (line > 0) fprintf(stderr, "%s:%d: %s\n", filename, line, error);
+    else fprintf(stderr, "%s: %s\n", filename, error);
+    free(g->adjmat);
+    free(g->label);
+    memset(g, 0, sizeof *g);
+    return -1;
+}
+
+static bool next_word(const unsigned char **p, const unsigned char *end, unsigned int *w) {
+    if (end - *p < 2)
+        return false;
+    *w = (unsigned int)(*p)[0] | (((unsigned int)(*p)[1]) << 8);
+    *p += 2;
+    return true;
+}
+
+// The binary format is a stream of little-endian 16-bit words: the number
+// of vertices, a label per vertex, then for each vertex the length of its
+// edge list and a (target, label) pair per edge. The file is mapped and
+// decoded in one pass, checking every word against the end of the map.
+// With labelled, the labels are read as in the labelled instances of the
+// ARG database: only the top bits of each word count, as many as give
+// about n/3 distinct labels. Edge labels keep at most EDGE_LABEL_BITS of
+// them, ARC_LABEL_BITS if directed, so that the adjacency matrix stays a
+// byte per pair. Returns the error, NULL if none.
+static const char *decode_binary(const unsigned char *p, const unsigned char *end, graph_t *g, bool directed, bool labelled) {
+    unsigned int nvertices, label, len, target;
+    if (!next_word(&p, end, &nvertices) || (size_t) (end - p) < 4 * (size_t) nvertices)
+        return "Error reading file.";
+    alloc_graph(g, nvertices);
+    if (g->adjmat == NULL || (g->label == NULL && nvertices > 0))
+        return "Cannot allocate the graph.";
+    int bits = 0;
+    while ((2u << bits) < nvertices * 33 / 100)
+        bits++;
+    int max_bits = directed ? ARC_LABEL_BITS : EDGE_LABEL_BITS;
+    int edge_bits = bits < max_bits ? bits : max_bits;
+    for (unsigned int i=0; i<nvertices; i++) {
+        next_word(&p, end, &label);
+        if (labelled) g->label[i] = label >> (16 - bits);
+    }
+
+    for (unsigned int i=0; i<nvertices; i++) {
+        if (!next_word(&p, end, &len) || (size_t) (end - p) < 4 * (size_t) len)
+            return "Error reading file.";
+        for (unsigned int j=0; j<len; j++) {
+            next_word(&p, end, &target);
+            next_word(&p, end, &label);
+            if (target >= nvertices)
+                return "Edge to a nonexistent vertex.";
+            add_edge(g, i, target, directed, labelled ? label >> (16 - edge_bits) : 0);
         }
     }
-	g->degree = calculate_degrees(g);
-    fclose(f);
+    return NULL;
 }
 
-// Precondition: *g is already zeroed out
-void readLadGraph(char* filename, graph_t* g) {
-    FILE* f;
-    int i;
-    if ((f=fopen(filename, "r"))==NULL){
-        free(g);
-    	fail("Cannot open file");
+int readBinaryGraph(char* filename, graph_t* g, bool directed, bool labelled) {
+    size_t size;
+    const unsigned char *map;
+    if (map_file(filename, &map, &size) != 0)
+        return -1;
+    const char *error = decode_binary(map, map + size, g, directed, labelled);
+    unmap_file(map, size);
+    return read_result(g, filename, 0, error);
+}
+
+typedef struct lad_reader_s {
+    const unsigned char *p, *end;
+    int line;
+} lad_reader_t;
+
+// Next non-negative integer of the mapped text, skipping whitespace and
+// counting lines for the error messages; false if there is none.
+static bool lad_int(lad_reader_t *r, int *x) {
+    const unsigned char *p = r->p;
+    while (p < r->end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        if (*p == '\n') r->line++;
+        p++;
     }
-    int nvertices = 0, w;
-    if (fscanf(f, "%d", &nvertices) != 1)
-        fail("Number of vertices not read correctly.\n");
-    g->n = nvertices;
-    g->label = calloc(g->n, sizeof *g->label);
-    g->adjmat = calloc(g->n, sizeof *g->adjmat);
-    for(i = 0; i < g->n; i++)
-    	g->adjmat[i] = calloc(g->n, sizeof *g->adjmat[i]);
+    if (p == r->end || *p < '0' || *p > '9')
+        return false;
+    long long v = 0;
+    while (p < r->end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        if (v > INT_MAX) return false;
+    }
+    r->p = p;
+    *x = (int) v;
+    return true;
+}
+
+// The LAD format is the number of vertices followed, for each vertex, by
+// its degree and its neighbours, its successors if directed. The file is
+// mapped and parsed in place. Returns the error, NULL if none.
+static const char *decode_lad(lad_reader_t *r, graph_t *g, bool directed) {
+    int nvertices, edge_count, w;
+    // each vertex takes at least a digit and a space
+    if (!lad_int(r, &nvertices) || nvertices > (r->end - r->p) / 2 + 1)
+        return "Number of vertices not read correctly.";
+    alloc_graph(g, nvertices);
+    if (g->adjmat == NULL || (g->label == NULL && nvertices > 0))
+        return "Cannot allocate the graph.";
     for (int i=0; i<nvertices; i++) {
-        int edge_count;
-        if (fscanf(f, "%d", &edge_count) != 1)
-            fail("Number of edges not read correctly.\n");
+        if (!lad_int(r, &edge_count))
+            return "Number of edges not read correctly.";
         for (int j=0; j<edge_count; j++) {
-            if (fscanf(f, "%d", &w) != 1)
-                fail("An edge was not read correctly.\n");
-            add_edge(g, i, w);
+            if (!lad_int(r, &w))
+                return "An edge was not read correctly.";
+            if (w >= nvertices)
+                return "Edge to a nonexistent vertex.";
+            add_edge(g, i, w, directed, 0);
         }
     }
-	g->degree = calculate_degrees(g);
-    fclose(f);
+    return NULL;
 }
 
-void readGraph(char* filename, graph_t* g, char format) {
-    if (format=='L') readLadGraph(filename, g);
-    else if (format=='B') readBinaryGraph(filename, g);
-    else fail("Unknown graph format\n");
+int readLadGraph(char* filename, graph_t* g, bool directed) {
+    size_t size;
+    const unsigned char *map;
+    if (map_file(filename, &map, &size) != 0)
+        return -1;
+    lad_reader_t r = { map, map + size, 1 };
+    const char *error = decode_lad(&r, g, directed);
+    unmap_file(map, size);
+    return read_result(g, filename, error != NULL ? r.line : 0, error);
+}
+
+int readGraph(char* filename, graph_t* g, char format, bool directed, bool labelled) {
+    if (format=='L') return readLadGraph(filename, g, directed);
+    if (format=='B') return readBinaryGraph(filename, g, directed, labelled);
+    fprintf(stderr, "Unknown graph format\n");
+    return -1;
 }
 
 graph_t *induced_subgraph(graph_t *g, int *vv) {
 	graph_t * subg = calloc(1, sizeof *subg);
-	subg->n = g->n;
-	subg->label = calloc(g->n, sizeof *subg->label);
-	subg->adjmat = calloc(g->n, sizeof *subg->adjmat);
-	for (int n = 0; n < g->n; n++) subg->adjmat[n] = calloc(g->n, sizeof *subg->adjmat[n]);
+	alloc_graph(subg, g->n);
 	for (int i = 0; i < subg->n; i++)
 		for (int j=0; j < subg->n; j++)
 			subg->adjmat[i][j] = g->adjmat[vv[i]][vv[j]];
-	for (int i=0; i<subg->n; i++)
+	subg->degree = malloc(g->n * sizeof *subg->degree + 1);
+	for (int i=0; i<subg->n; i++) {
 		subg->label[i] = g->label[vv[i]];
-	subg->degree = calculate_degrees(subg);
+		subg->degree[i] = g->degree[vv[i]];
+	}
+	subg->twin = calculate_twins(subg);
 	return subg;
 }
 
@@ -147,23 +301,33 @@ int graph_edge_count(graph_t *g) {
 }
 
 void free_graph(graph_t *g){
-	for(int i = 0; i < g->n; i++)
-		free(g->adjmat[i]);
 	free(g->adjmat);
 	free(g->label);
 	free(g->degree);
+	free(g->twin);
 	free(g);
 	return;
 }
 
+// A counting sort, stable, so ties stay by index, in O(n + max degree)
+int *degree_order(graph_t *g, bool ascending){
+	unsigned int max_degree = 0;
+	for (int v = 0; v < g->n; v++)
+		if (g->degree[v] > max_degree) max_degree = g->degree[v];
+	unsigned int *start = calloc(max_degree + 2, sizeof *start);
+	for (int v = 0; v < g->n; v++)
+		start[(ascending ? g->degree[v] : max_degree - g->degree[v]) + 1]++;
+	for (unsigned int d = 0; d <= max_degree; d++)
+		start[d + 1] += start[d];
+	int *vv = malloc(g->n * sizeof *vv + 1);
+	for (int v = 0; v < g->n; v++)
+		vv[start[ascending ? g->degree[v] : max_degree - g->degree[v]]++] = v;
+	free(start);
+	return vv;
+}
+
 graph_t *sort_vertices_by_degree(graph_t *g, bool ascending ){
-	int *vv = malloc(g->n * sizeof *vv );
-	for (int i=0; i<g->n; i++) vv[i] = i;
-	if (ascending) {
-		INSERTION_SORT(int, vv, g->n, (g->degree[vv[j-1]] > g->degree[vv[j]]))
-	} else {
-		INSERTION_SORT(int, vv, g->n, (g->degree[vv[j-1]] < g->degree[vv[j]]))
-	}
+	int *vv = degree_order(g, ascending);
 
 	graph_t *g_sorted = induced_subgraph(g, vv);
 	free(vv);
@@ -171,5 +335,66 @@ graph_t *sort_vertices_by_degree(graph_t *g, bool ascending ){
 	return g_sorted;
 }
 
+static int count_classes(unsigned long long *color, int n) {
+	unsigned long long *c = malloc(n * sizeof *c);
+	for (int i = 0; i < n; i++) c[i] = color[i];
+	INSERTION_SORT(unsigned long long, c, n, (c[j-1] > c[j]))
+	int classes = n > 0;
+	for (int i = 1; i < n; i++)
+		classes += c[i] != c[i-1];
+	free(c);
+	return classes;
+}
+
+// Colour refinement: colours start from degree and label, and are refined
+// with the colours of the neighbours, and the labels of the edges to them,
+// until the number of classes stops growing. canon[i] is the vertex that comes i-th by colour and, within a
+// class, by degree order, and the result is a hash of g renumbered by canon.
+// Ties left by the refinement are broken by vertex index, not by individualising
+// vertices, so this is not a true canonical form: a hit is only guaranteed for
+// copies that end in the same numbering, e.g. when the refinement splits all
+// the vertices or the tied ones keep their relative order; other isomorphic
+// copies may miss. Non-isomorphic graphs only match by collision.
+unsigned long long canonical_form(graph_t *g, int *canon) {
+	int n = g->n;
+	unsigned long long *color = malloc(n * sizeof *color), *next = malloc(n * sizeof *next), *tmp;
+	for (int v = 0; v < n; v++)
+		color[v] = vertex_key(((unsigned long long) g->degree[v] << 32) | g->label[v]);
+	int classes = count_classes(color, n);
+	for (int round = 0; round < n; round++) {
+		for (int v = 0; v < n; v++) {
+			unsigned long long sum = 0;
+			for (int w = 0; w < n; w++)
+				if (g->adjmat[v][w]) sum += vertex_key(color[w] + g->adjmat[v][w] - 1);
+			next[v] = vertex_key(color[v] ^ vertex_key(sum));
+		}
+		tmp = color; color = next; next = tmp;
+		int c = count_classes(color, n);
+		if (c == classes) break;
+		classes = c;
+	}
 
+	int *vv = degree_order(g, false);
+	for (int i = 0; i < n; i++) canon[i] = vv[i];
+	INSERTION_SORT(int, canon, n, (color[canon[j-1]] > color[canon[j]]))
 
+	unsigned long long h = vertex_key(n);
+	for (int i = 0; i < n; i++) {
+		h = vertex_key(h ^ g->label[canon[i]]);
+		unsigned long long word = 0;
+		for (int j = 0; j < n; j++) {
+			unsigned char edge = g->adjmat[canon[i]][canon[j]];
+			if (edge > 1)
+				h = vertex_key(h ^ ((unsigned long long) j << 8 | edge));
+			word |= (unsigned long long) (edge != 0) << (j % 64);
+			if (j % 64 == 63 || j == n - 1) {
+				h = vertex_key(h ^ word);
+				word = 0;
+			}
+		}
+	}
+	free(vv);
+	free(color);
+	free(next);
+	return h;
+}
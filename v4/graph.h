@@ -38,31 +38,53 @@
 
 typedef unsigned char uchar;
 
+#define EDGE_LABEL_BITS 7      // so that 1 + an edge label fits in a byte of adjmat
+#define ARC_LABEL_BITS 3       // and in half a byte for the arcs of directed graphs
+
 typedef struct graph_s {
     int n;
     unsigned char **adjmat;
     unsigned int *label;
     unsigned int *degree;
+    unsigned int *twin;
 }graph_t;
 
+// Sets g->n and allocates zeroed labels and adjacency matrix
+void alloc_graph(graph_t *g, int n);
+
 unsigned int* calculate_degrees(graph_t *g);
 
+unsigned int* calculate_twins(graph_t *g);
+
+// A copy of g renumbered so that vertex i is vertex vv[i] of g, whose
+// degrees are moved rather than counted
 graph_t *induced_subgraph(graph_t *g, int *vv);
 
+void add_edge(graph_t *g, int v, int w, bool directed, unsigned int label);
+
 int graph_edge_count(graph_t *g);
 
+// format is 'B' (binary) or 'L' (LAD); the labels of binary files are
+// only read if labelled. The readers return 0, or -1 if the file cannot be
+// read: the reason goes to stderr and *g is left zeroed out.
 // Precondition: *g is already zeroed out
-void readGraph(char* filename, graph_t* g, char format);
+int readGraph(char* filename, graph_t* g, char format, bool directed, bool labelled);
 
 // Precondition: *g is already zeroed out
-void readBinaryGraph(char* filename, graph_t* g);
+int readBinaryGraph(char* filename, graph_t* g, bool directed, bool labelled);
 
 // Precondition: *g is already zeroed out
-void readLadGraph(char* filename, graph_t* g);
+int readLadGraph(char* filename, graph_t* g, bool directed);
 
 void free_graph(graph_t *g);
 
+// vv[i] is the vertex of g that comes i-th by degree
+int *degree_order(graph_t *g, bool ascending);
+
 graph_t *sort_vertices_by_degree(graph_t *g, bool ascending );
 
+// Precondition: g->degree is computed
+unsigned long long canonical_form(graph_t *g, int *canon);
+
 #endif /* GRAPH_H_ */
 
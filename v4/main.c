@@ -16,26 +16,66 @@
  *  along with this program.If not, see < http: *www.gnu.org/licenses/>
  */
 
-#include "threadpool.h"
+#define _GNU_SOURCE
+
+#include <argp.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "mcs.h"
+#include "server.h"
+
+typedef unsigned int uint;
 
 static struct argp_option options[] = { { "quiet", 'q', 0, 0, "Quiet output" },
                                         { "verbose", 'v', 0, 0, "Verbose output" },
 										{"lad", 'l', 0, 0, "Read LAD format"},
+                                        { "labelled", 'L', 0, 0, "Match the vertex and edge labels of binary files" },
+                                        { "directed", 'i', 0, 0, "Read the graphs as directed, and match arcs with arcs of the same direction" },
                                         { "connected", 'c', 0, 0, "Solve max common CONNECTED subgraph problem" },
-                                        { "threads", 'n', 0, 0, "Number of threads used" },
-                                        {"timeout", 't', "timeout", 0, "Set timeout of TIMEOUT milliseconds"},
+                                        { "threads", 'n', "N", 0, "Number of threads used" },
+                                        {"timeout", 't', "timeout", 0, "Set timeout of TIMEOUT seconds"},
+                                        { "k-down", 'k', 0, 0, "Look for a solution of size min(n0,n1)-k for k = 0, 1, 2, ..." },
+                                        { "at-least", 'a', "K", 0, "Stop as soon as a common subgraph of K vertices is found, or proven not to exist" },
+                                        { "ratio", 'r', "R", 0, "Same as --at-least with K = R * min(n0,n1), rounded up" },
+                                        { "split-level", 's', "LEVEL", 0, "Hand the subtrees at depth LEVEL to the thread pool" },
+                                        { "batch", 'B', "FILE", 0, "Solve the pairs of graphs listed in FILE, two file names per line, - for stdin" },
+                                        { "all-pairs", 'A', "DIR", 0, "Print the matrix of the sizes for all the pairs of graphs in DIR" },
+                                        { "cache", 'C', "FILE", 0, "Keep the results in FILE, and answer or warm start from it (not with --all-pairs)" },
+                                        { "server", 'S', "SOCKET", 0, "Serve requests on the Unix socket SOCKET with N workers, - for stdin and stdout" },
+                                        { "db", 'D', "DB", 0, "Graphs are names, or ids, of graphs in the database DB, in single and batch mode" },
+                                        { "query", 'Q', "FILE", 0, "Print the graphs of the database --db with the largest common subgraphs with the graph in FILE" },
+                                        { "top", 'T', "K", 0, "Number of graphs printed by --query, 10 by default" },
+                                        { "bounds", 'U', 0, 0, "Only print the lower and upper bounds that need no search, in single and batch mode" },
                                         { 0 }
 };
 
 static char doc[] = "Find a maximum isomorphic graph";
-static char args_doc[] = "FILENAME1 FILENAME2";
+static char args_doc[] = "FILENAME1 FILENAME2\n--batch=FILE\n--all-pairs=DIR\n--server=SOCKET\n--db=DB --query=FILE";
 static struct {
     bool quiet;
     bool verbose;
     bool lad;
-    int timeout;
+    bool labelled;
+    bool directed;
+    double timeout;
     bool connected;
+    bool k_down;
+    int at_least;
+    double ratio;
     uint n_threads;
+    int split_level;            // -1 for the default of the library
+    char *batch;
+    char *all_pairs;
+    char *server;
+    char *cache;
+    char *db;
+    char *query;
+    int top;
+    bool bounds;
     char *filename1;
     char *filename2;
     int arg_num;
@@ -45,9 +85,23 @@ void set_default_arguments() {
     arguments.quiet = false;
     arguments.verbose = false;
     arguments.lad = false;
+    arguments.labelled = false;
+    arguments.directed = false;
     arguments.timeout = 0;
     arguments.connected = false;
-    arguments.n_threads = DEFAULT_THREADS;
+    arguments.k_down = false;
+    arguments.at_least = 0;
+    arguments.ratio = 0;
+    arguments.n_threads = MCS_DEFAULT_THREADS;
+    arguments.split_level = -1;
+    arguments.batch = NULL;
+    arguments.all_pairs = NULL;
+    arguments.server = NULL;
+    arguments.cache = NULL;
+    arguments.db = NULL;
+    arguments.query = NULL;
+    arguments.top = 10;
+    arguments.bounds = false;
     arguments.filename1 = NULL;
     arguments.filename2 = NULL;
     arguments.arg_num = 0;
@@ -58,11 +112,17 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             arguments.quiet = true;
             break;
 		case 't':
-	    	arguments.timeout = strtol(arg, NULL, 10);
+	    	arguments.timeout = strtod(arg, NULL);
         break;
         case 'l':
         	arguments.lad = true;
         	break;
+        case 'L':
+            arguments.labelled = true;
+            break;
+        case 'i':
+            arguments.directed = true;
+            break;
         case 'n':
 	    	arguments.n_threads = strtol(arg, NULL, 10);
         	break;
@@ -72,6 +132,44 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
         case 'c':
             arguments.connected = true;
             break;
+        case 'k':
+            arguments.k_down = true;
+            break;
+        case 'a':
+            arguments.at_least = strtol(arg, NULL, 10);
+            break;
+        case 'r':
+            arguments.ratio = strtod(arg, NULL);
+            break;
+        case 's':
+            arguments.split_level = strtol(arg, NULL, 10);
+            if (arguments.split_level < 0) arguments.split_level = 0;
+            if (arguments.split_level >= MCS_MAX_VERTICES) arguments.split_level = MCS_MAX_VERTICES - 1;
+            break;
+        case 'B':
+            arguments.batch = arg;
+            break;
+        case 'A':
+            arguments.all_pairs = arg;
+            break;
+        case 'S':
+            arguments.server = arg;
+            break;
+        case 'C':
+            arguments.cache = arg;
+            break;
+        case 'D':
+            arguments.db = arg;
+            break;
+        case 'Q':
+            arguments.query = arg;
+            break;
+        case 'T':
+            arguments.top = strtol(arg, NULL, 10);
+            break;
+        case 'U':
+            arguments.bounds = true;
+            break;
         case ARGP_KEY_ARG:
             if (arguments.arg_num == 0) {
                 arguments.filename1 = arg;
@@ -83,7 +181,9 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             arguments.arg_num++;
             break;
         case ARGP_KEY_END:
-            if (arguments.arg_num == 0)
+            if (arguments.batch == NULL && arguments.all_pairs == NULL && arguments.server == NULL && arguments.query == NULL ? arguments.arg_num != 2 : arguments.arg_num != 0)
+                argp_usage(state);
+            if (arguments.query != NULL && arguments.db == NULL)
                 argp_usage(state);
             break;
         default:
@@ -92,112 +192,320 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
     return 0;
 }
 static struct argp argp = { options, parse_opt, args_doc, doc };
-struct timespec start;
-
-void mcs(uchar incumbent[][2], uchar *inc_pos) {
-    uint bd_pos = 0, bd_n = 0;
-    uchar cur[MAX_GRAPH_SIZE][2];
-    uchar domains[MAX_GRAPH_SIZE * 5][BDS];
-    uchar left[n0], right[n1];
-    uchar v, w, *bd;
-    for (uchar i = 0; i < n0; i++)
-        left[i] = i;
-    for (uchar i = 0; i < n1; i++)
-        right[i] = i;
-    add_bidomain(domains, &bd_pos, 0, 0, n0, n1, 0, 0);
-
-    pool_t *pool = init_pool(arguments.n_threads, arguments.timeout, start, arguments.connected);
-
-    while (bd_pos > 0) {
-    
-    	if (arguments.timeout && compute_elapsed_millisec(start) > arguments.timeout) {
-        	arguments.timeout = -1;
-        	break;
-   		}
-    
-		    bd = &domains[bd_pos - 1][L];
-
-		    if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] <= *inc_pos || (bd[LL] == 0 && bd[RL] == bd[IRL]))
-		        bd_pos--;
-		    else {
-
-		    	select_bidomain(domains, bd_pos, left, domains[bd_pos - 1][P], arguments.connected);
-
-		        if(bd[P]==POOL_LEVEL){
-		            if(fill_pool_args(pool, domains, cur, left, right, &bd_pos, bd_n, *inc_pos))
-		                compute(pool, inc_pos, incumbent);
-		        } else {
-		            v = select_next_v(left, bd);
-		            if ((bd[W] = select_next_w(right, bd)) != UCHAR_MAX) {
-		                w = right[bd[R] + bd[W]];       // swap the W after the bottom of the current right domain
-		                right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
-		                right[bd[R] + bd[RL]] = w;
-		                bd[W] = w;                      // store the W used for this iteration
-		                cur[bd[P]][L] = v;
-		                cur[bd[P]][R] = w;
-		                update_incumbent(cur, incumbent, bd[P] + (uchar) 1, inc_pos, DEFAULT_THREADS);
-		                generate_next_domains(domains, &bd_pos, bd[P] + 1, left, right, v, w, *inc_pos);
-		            }
-		        }
-		    }
-
-    }
-    if(arguments.timeout >= 0 && pool->n_th > 0)
-        compute(pool, inc_pos, incumbent);
-
-    arguments.timeout = stop_pool(pool);
+
+// The format and flags of the graph files, as mcs_graph_read takes them
+char input_format() {
+    return arguments.lad ? 'L' : 'B';
+}
+
+int input_flags() {
+    return (arguments.directed ? MCS_GRAPH_DIRECTED : 0) | (arguments.labelled ? MCS_GRAPH_LABELLED : 0);
+}
+
+void set_options(mcs_options_t *opt, mcs_graph_t *g0, mcs_graph_t *g1) {
+    int n0 = mcs_graph_size(g0), n1 = mcs_graph_size(g1);
+    int min_size = n0 < n1 ? n0 : n1;
+    mcs_default_options(opt);
+    opt->engine = arguments.k_down ? MCS_ENGINE_K_DOWN : MCS_ENGINE_PARALLEL;
+    opt->timeout = arguments.timeout;
+    opt->connected = arguments.connected;
+    if (arguments.split_level >= 0) opt->split_level = arguments.split_level;
+    opt->verbose = arguments.verbose;
+    opt->threshold = arguments.at_least;
+    if (arguments.ratio > 0) {
+        double k = arguments.ratio * min_size;
+        opt->threshold = (uint)k + ((uint)k < k);
+    }
+}
+
+// With --db, name is looked up in db, and taken as an id if no graph has that name
+mcs_db_t *db;
+
+mcs_graph_t *read_graph(const char *name, char format) {
+    if (db == NULL)
+        return mcs_graph_read(name, format, input_flags());
+    int id = mcs_db_find(db, name);
+    if (id < 0) {
+        char *end;
+        long k = strtol(name, &end, 10);
+        if (*name != '\0' && *end == '\0' && k >= 0 && k < mcs_db_size(db))
+            id = k;
+    }
+    return mcs_db_graph(db, id);
+}
+
+// BATCH MODE //////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Graphs are read and sorted once and kept by file name, and all the pairs
+// are solved by the same solver, so its thread pool stays warm.
+
+#define CACHE_BUCKETS 4096
+
+typedef struct cached_graph_s {
+    char *filename;
+    mcs_graph_t *g;             // NULL if the file cannot be read
+    struct cached_graph_s *next;
+} cached_graph_t;
+
+cached_graph_t *graph_cache[CACHE_BUCKETS];
+
+mcs_graph_t *cached_graph(const char *filename, char format) {
+    uint h = 2166136261u;      // FNV-1a
+    for (const char *c = filename; *c; c++)
+        h = (h ^ (unsigned char) *c) * 16777619u;
+    cached_graph_t **bucket = &graph_cache[h % CACHE_BUCKETS];
+    for (cached_graph_t *e = *bucket; e != NULL; e = e->next)
+        if (strcmp(e->filename, filename) == 0)
+            return e->g;
+    cached_graph_t *e = malloc(sizeof *e);
+    e->filename = strdup(filename);
+    e->g = read_graph(filename, format);
+    if (e->g != NULL)
+        mcs_graph_prepare(e->g);
+    e->next = *bucket;
+    *bucket = e;
+    return e->g;
+}
+
+void free_graph_cache() {
+    for (int i = 0; i < CACHE_BUCKETS; i++)
+        while (graph_cache[i] != NULL) {
+            cached_graph_t *e = graph_cache[i];
+            graph_cache[i] = e->next;
+            if (e->g != NULL) mcs_graph_free(e->g);
+            free(e->filename);
+            free(e);
+        }
+}
+
+// One line per pair, written as soon as it is solved: FILENAME1 FILENAME2 SIZE TIME STATUS,
+// or FILENAME1 FILENAME2 LOWER UPPER with --bounds
+int run_batch(mcs_solver_t *solver) {
+    FILE *f = strcmp(arguments.batch, "-") == 0 ? stdin : fopen(arguments.batch, "r");
+    if (f == NULL) {
+        printf("Cannot open file\n");
+        return 1;
+    }
+    char format = input_format();
+    char *line = NULL, name0[4096], name1[4096];
+    size_t line_size = 0;
+    mcs_options_t opt;
+    mcs_result_t res;
+    while (getline(&line, &line_size, f) != -1) {
+        if (line[0] == '#' || sscanf(line, "%4095s %4095s", name0, name1) != 2)
+            continue;
+        mcs_graph_t *g0 = cached_graph(name0, format);
+        mcs_graph_t *g1 = cached_graph(name1, format);
+        // missing, truncated or malformed files: mcs_graph_read gives NULL
+        if (g0 == NULL || g1 == NULL) {
+            printf("%s %s 0 0 error\n", name0, name1);
+            fflush(stdout);
+            continue;
+        }
+        if (arguments.bounds) {
+            mcs_bounds_t b;
+            mcs_bounds(g0, g1, arguments.connected, &b);
+            printf("%s %s %d %d\n", name0, name1, b.lower, b.upper);
+            continue;
+        }
+        set_options(&opt, g0, g1);
+        mcs_solve(solver, g0, g1, &opt, &res);
+        if (res.status != MCS_ERROR && !mcs_check(g0, g1, &res))
+            printf("*** Error: Invalid solution\n");
+        printf("%s %s %d %.6f %s\n", name0, name1, res.size, res.time, mcs_status_name(res.status));
+        fflush(stdout);
+    }
+    free(line);
+    if (f != stdin) fclose(f);
+    free_graph_cache();
+    return 0;
+}
+
+// ALL PAIRS ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The first line lists the graphs, then each row starts with a graph and
+// gives its sizes against all of them; a * marks the pairs that timed out.
+// --ratio is not used, as the threshold has to be the same for all pairs.
+int run_all_pairs() {
+    struct dirent **entries;
+    int n_entries = scandir(arguments.all_pairs, &entries, NULL, alphasort);
+    if (n_entries < 0) {
+        printf("Cannot open directory\n");
+        return 1;
+    }
+    char format = input_format();
+    char path[4096];
+    struct stat st;
+    mcs_graph_t **graphs = malloc(n_entries * sizeof *graphs);
+    char **names = malloc(n_entries * sizeof *names);
+    int n = 0;
+    for (int i = 0; i < n_entries; i++) {
+        snprintf(path, sizeof path, "%s/%s", arguments.all_pairs, entries[i]->d_name);
+        if (entries[i]->d_name[0] != '.' && stat(path, &st) == 0 && S_ISREG(st.st_mode)
+                && (graphs[n] = mcs_graph_read(path, format, input_flags())) != NULL)
+            names[n++] = entries[i]->d_name;
+    }
+
+    mcs_options_t opt;
+    mcs_default_options(&opt);
+    opt.timeout = arguments.timeout;
+    opt.connected = arguments.connected;
+    opt.threshold = arguments.at_least;
+    uint *sizes = malloc(n * n * sizeof *sizes);
+    int *status = malloc(n * n * sizeof *status);
+    int ret = mcs_solve_all(graphs, n, arguments.n_threads, &opt, sizes, status);
+    if (ret == MCS_ERROR)
+        printf("Graphs larger than %d vertices or invalid options\n", MCS_MAX_VERTICES);
+    else {
+        for (int i = 0; i < n; i++)
+            printf("%s%s", names[i], i < n - 1 ? " " : "\n");
+        for (int i = 0; i < n; i++) {
+            printf("%s", names[i]);
+            for (int j = 0; j < n; j++)
+                printf(" %d%s", sizes[i * n + j], status[i * n + j] == MCS_TIMEOUT ? "*" : "");
+            printf("\n");
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+        mcs_graph_free(graphs[i]);
+    for (int i = 0; i < n_entries; i++)
+        free(entries[i]);
+    free(entries);
+    free(graphs);
+    free(names);
+    free(sizes);
+    free(status);
+    return ret == MCS_ERROR;
+}
+
+// QUERY ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// One line per match, best first: RANK NAME SIZE BOUND STATUS
+int run_query() {
+    mcs_graph_t *query = mcs_graph_read(arguments.query, input_format(), input_flags());
+    if (query == NULL) {
+        printf("Cannot open file\n");
+        return 1;
+    }
+    mcs_options_t opt;
+    mcs_default_options(&opt);
+    opt.timeout = arguments.timeout;
+    opt.connected = arguments.connected;
+    mcs_match_t *top = malloc((arguments.top > 0 ? arguments.top : 1) * sizeof *top);
+    int solved, found = mcs_query(query, db, arguments.top, arguments.n_threads, &opt, top, &solved);
+    if (found == MCS_ERROR)
+        printf("Query larger than %d vertices or invalid options\n", MCS_MAX_VERTICES);
+    else {
+        mcs_db_entry_t e;
+        for (int i = 0; i < found; i++) {
+            mcs_db_entry(db, top[i].id, &e);
+            printf("%d %s %d %d %s\n", i + 1, e.name, top[i].size, top[i].bound, mcs_status_name(top[i].status));
+        }
+        if (!arguments.quiet)
+            printf("searched %d of %d graphs\n", solved, mcs_db_size(db));
+    }
+    free(top);
+    mcs_graph_free(query);
+    mcs_db_close(db);
+    return found == MCS_ERROR;
 }
 
 int main(int argc, char** argv) {
     set_default_arguments();
     argp_parse(&argp, argc, argv, 0, 0, 0);
-    struct timespec finish;
-    double time_elapsed;
-
-    char format = arguments.lad ? 'L' : 'B';
-    graph_t *g0 = (graph_t*) calloc(1, sizeof *g0);
-    readGraph(arguments.filename1, g0, format);
-    graph_t *g1 = (graph_t*) calloc(1, sizeof *g1);
-    readGraph(arguments.filename2, g1, format);
-    g0 = sort_vertices_by_degree(g0, (graph_edge_count(g1) > g1->n * (g1->n - 1) / 2));
-    g1 = sort_vertices_by_degree(g1, (graph_edge_count(g0) > g0->n * (g0->n - 1) / 2));
-    int min_size = MIN(g0->n, g1->n);
-    n0 = g0->n;
-    n1 = g1->n;
-
-    for (int i = 0; i < n0; i++){
-        for (int j = 0; j < n0; j++)
-            adjmat0[i][j] = g0->adjmat[i][j];
-	}
-    for (int i = 0; i < n1; i++){
-        for (int j = 0; j < n1; j++)
-            adjmat1[i][j] = g1->adjmat[i][j];
-	}
-    uchar solution[min_size][2];
-    uchar sol_len = 0;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    mcs(solution, &sol_len);
-    clock_gettime(CLOCK_MONOTONIC, &finish);
 
-    if(arguments.timeout == -1)
+    if (arguments.all_pairs != NULL)
+        return run_all_pairs();
+    if (arguments.db != NULL && (db = mcs_db_open(arguments.db)) == NULL) {
+        printf("Cannot open database\n");
+        return 1;
+    }
+    if (arguments.query != NULL)
+        return run_query();
+    mcs_cache_t *cache = NULL;
+    if (arguments.cache != NULL && (cache = mcs_cache_open(arguments.cache)) == NULL) {
+        printf("Cannot open file\n");
+        return 1;
+    }
+    if (arguments.server != NULL) {
+        mcs_options_t opt;
+        mcs_default_options(&opt);
+        opt.timeout = arguments.timeout;
+        opt.connected = arguments.connected;
+        opt.threshold = arguments.at_least;
+        return run_server(arguments.server, arguments.n_threads, input_format(), input_flags(), &opt, cache);
+    }
+
+    mcs_solver_t *solver = mcs_solver_create(arguments.n_threads);
+    if (solver == NULL) {
+        printf("Invalid number of threads\n");
+        return 1;
+    }
+    mcs_solver_set_cache(solver, cache);
+    if (arguments.batch != NULL) {
+        int ret = run_batch(solver);
+        mcs_solver_free(solver);
+        if (cache != NULL) mcs_cache_close(cache);
+        if (db != NULL) mcs_db_close(db);
+        return ret;
+    }
+
+    char format = input_format();
+    mcs_graph_t *g0 = read_graph(arguments.filename1, format);
+    mcs_graph_t *g1 = read_graph(arguments.filename2, format);
+    if (g0 == NULL || g1 == NULL) {
+        printf("Cannot open file\n");
+        return 1;
+    }
+    int n0 = mcs_graph_size(g0), n1 = mcs_graph_size(g1);
+    if (format != 'L')
+        printf("%d vertices\n%d vertices\n", n0, n1);
+    int min_size = n0 < n1 ? n0 : n1;
+
+    if (arguments.bounds) {
+        mcs_bounds_t b;
+        mcs_bounds(g0, g1, arguments.connected, &b);
+        printf("lower %d upper %d (size %d, labels %d, degrees %d)\n", b.lower, b.upper, b.size_bound, b.label_bound, b.degree_bound);
+        mcs_solver_free(solver);
+        mcs_graph_free(g0);
+        mcs_graph_free(g1);
+        if (db != NULL) mcs_db_close(db);
+        return 0;
+    }
+
+    mcs_options_t opt;
+    set_options(&opt, g0, g1);
+    if (opt.threshold > min_size && !arguments.quiet)
+        printf("root bound %d below threshold\n", min_size);
+
+    mcs_result_t res;
+    if (mcs_solve(solver, g0, g1, &opt, &res) == MCS_ERROR) {
+        printf("Graphs larger than %d vertices or invalid options\n", MCS_MAX_VERTICES);
+        return 1;
+    }
+
+    if (res.cached && !arguments.quiet)
+        printf("Answered from the cache\n");
+    if (res.status == MCS_TIMEOUT)
     	printf("TIMEOUT\n");
+    else if (opt.threshold)
+        printf("Threshold %d %s\n", opt.threshold, res.status == MCS_THRESHOLD_REACHED ? "reached" : "not reachable");
 
-    printf("SOLUTION size:%d\nsol: ", sol_len);
-    for (int i = 0; i < g0->n; i++)
-    for (int j = 0; j < sol_len; j++){
-        if (solution[j][L] == i)
-            printf("|%2d %2d| ", solution[j][L], solution[j][R]);
+    printf("SOLUTION size:%d\nsol: ", res.size);
+    for (int i = 0; i < n0; i++)
+    for (int j = 0; j < res.size; j++){
+        if (res.map[j][0] == i)
+            printf("|%2d %2d| ", res.map[j][0], res.map[j][1]);
 	}
     printf("\n");
 
-    if (!check_sol(g0, g1, solution, sol_len)) {
+    if (!mcs_check(g0, g1, &res)) {
         printf("*** Error: Invalid solution\n");
     }
-    time_elapsed = (finish.tv_sec - start.tv_sec); // calculating elapsed seconds
-    time_elapsed += (double) (finish.tv_nsec - start.tv_nsec) / 1000000000.0; // adding elapsed nanoseconds
-    printf(">>> %d - %015.10f\n", sol_len, time_elapsed);
+    printf(">>> %d - %015.10f\n", res.size, res.time);
 
-    free_graph(g0);
-    free_graph(g1);
+    mcs_solver_free(solver);
+    if (cache != NULL) mcs_cache_close(cache);
+    mcs_graph_free(g0);
+    mcs_graph_free(g1);
+    if (db != NULL) mcs_db_close(db);
     return 0;
 }
@@ -0,0 +1,1038 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#include "mcs.h"
+#include "threadpool.h"
+#include "cache.h"
+#include "db.h"
+#include "bounds.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct mcs_graph_s {
+    graph_t *g;                     // numbered as given by the caller
+    graph_t *sorted[2];             // by decreasing [0] and increasing [1] degree, built on first use
+    int *order[2];                  // vertex i of sorted[k] is vertex order[k][i] of g
+    int *canon, *canon_pos;         // canonical numbering: vertex i is vertex canon[i] of g, v of g is canon_pos[v]; NULL until used
+    unsigned long long hash;        // of g in the canonical numbering
+    bool view;                      // the arrays point into a .mcsg image, and only the row pointers are allocated
+    void *map;                      // the mapped .mcsg file, if the graph owns it
+    size_t map_size;
+};
+
+struct mcs_solver_s {
+    pool_t *pool;                   // NULL for a solver without threads
+    problem_t pb;
+    mcs_options_t opt;
+    uint target;                    // stop as soon as the incumbent reaches this size, 0 to search for the optimum
+    double timeout;                 // seconds, -1 once expired
+    struct timespec start;
+    uchar incumbent[MAX_GRAPH_SIZE][2];
+    uchar inc_pos;
+    cache_t *cache;                 // NULL without cache
+};
+
+// GRAPHS //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static mcs_graph_t *wrap_graph(graph_t *g) {
+    mcs_graph_t *mg = calloc(1, sizeof *mg);
+    mg->g = g;
+    return mg;
+}
+
+mcs_graph_t *mcs_graph_create(int n) {
+    if (n < 0) return NULL;
+    graph_t *g = calloc(1, sizeof *g);
+    alloc_graph(g, n);
+    return wrap_graph(g);
+}
+
+static mcs_graph_t *map_graph(const char *filename);
+
+mcs_graph_t *mcs_graph_read(const char *filename, char format, int flags) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) return NULL;
+    char magic[4];
+    bool mcsg = fread(magic, 1, sizeof magic, f) == sizeof magic && memcmp(magic, MCSG_MAGIC, sizeof magic) == 0;
+    fclose(f);
+    if (mcsg)
+        return map_graph(filename);
+    graph_t *g = calloc(1, sizeof *g);
+    if (readGraph((char *) filename, g, format, flags & MCS_GRAPH_DIRECTED, flags & MCS_GRAPH_LABELLED) != 0) {
+        free(g);
+        return NULL;
+    }
+    return wrap_graph(g);
+}
+
+static void forget_order(mcs_graph_t *g) {
+    for (int k = 0; k < 2; k++) {
+        if (g->sorted[k] != NULL) free_graph(g->sorted[k]);
+        free(g->order[k]);
+        g->sorted[k] = NULL;
+        g->order[k] = NULL;
+    }
+    free(g->canon);
+    free(g->canon_pos);
+    g->canon = g->canon_pos = NULL;
+    free(g->g->degree);
+    g->g->degree = NULL;
+}
+
+void mcs_graph_add_edge(mcs_graph_t *g, int v, int w) {
+    mcs_graph_add_labelled_edge(g, v, w, 0);
+}
+
+void mcs_graph_add_labelled_edge(mcs_graph_t *g, int v, int w, unsigned int label) {
+    if (g->view || v < 0 || w < 0 || v >= g->g->n || w >= g->g->n || label > MCS_MAX_EDGE_LABEL) return;
+    forget_order(g);
+    add_edge(g->g, v, w, false, label);
+}
+
+void mcs_graph_add_arc(mcs_graph_t *g, int v, int w, unsigned int label) {
+    if (g->view || v < 0 || w < 0 || v >= g->g->n || w >= g->g->n || label > MCS_MAX_ARC_LABEL) return;
+    forget_order(g);
+    add_edge(g->g, v, w, true, label);
+}
+
+void mcs_graph_set_label(mcs_graph_t *g, int v, unsigned int label) {
+    if (g->view || v < 0 || v >= g->g->n || label > MCS_MAX_VERTEX_LABEL) return;
+    forget_order(g);
+    g->g->label[v] = label | (g->g->label[v] & (1u << 31));
+}
+
+int mcs_graph_size(const mcs_graph_t *g) {
+    return g->g->n;
+}
+
+static graph_t *sorted_graph(mcs_graph_t *g, int k) {
+    if (g->g->degree == NULL)
+        g->g->degree = calculate_degrees(g->g);
+    if (g->sorted[k] == NULL) {
+        g->order[k] = degree_order(g->g, k);
+        g->sorted[k] = induced_subgraph(g->g, g->order[k]);
+    }
+    return g->sorted[k];
+}
+
+static void canonical(mcs_graph_t *g) {
+    sorted_graph(g, 0);
+    if (g->canon == NULL) {
+        g->canon = malloc(g->g->n * sizeof *g->canon);
+        g->canon_pos = malloc(g->g->n * sizeof *g->canon_pos);
+        g->hash = canonical_form(g->g, g->canon);
+        for (int i = 0; i < g->g->n; i++)
+            g->canon_pos[g->canon[i]] = i;
+    }
+}
+
+void mcs_graph_prepare(mcs_graph_t *g) {
+    sorted_graph(g, 0);
+    sorted_graph(g, 1);
+    canonical(g);
+}
+
+void mcs_graph_free(mcs_graph_t *g) {
+    if (g->view) {
+        graph_t *graphs[3] = { g->g, g->sorted[0], g->sorted[1] };
+        for (int k = 0; k < 3; k++) {
+            free(graphs[k]->adjmat);
+            free(graphs[k]);
+        }
+        if (g->map != NULL) munmap(g->map, g->map_size);
+        free(g);
+        return;
+    }
+    forget_order(g);
+    free_graph(g->g);
+    free(g);
+}
+
+// GRAPH FILES /////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A .mcsg file is a graph after mcs_graph_prepare, laid out so that all the
+// arrays of mcs_graph_s can point into the mapped file:
+//
+//   header        magic, version, n and hash
+//   3 x 3 x n     label, degree and twin of g, sorted[0] and sorted[1] (uint32)
+//   4 x n         order[0], order[1], canon and canon_pos (int32)
+//   3 x n x n     adjacency rows of g, sorted[0] and sorted[1] (one byte per entry)
+//
+// Numbers are in the byte order of the machine that wrote the file.
+
+#define MCSG_VERSION 2                      // 2: loops are the top bit of the label, edges keep their labels
+
+typedef struct mcsg_header_s {
+    char magic[4];
+    uint32_t version;
+    uint32_t n;
+    uint32_t pad;
+    uint64_t hash;
+} mcsg_header_t;
+
+_Static_assert(sizeof(unsigned int) == sizeof(uint32_t) && sizeof(int) == sizeof(int32_t), "mcsg arrays are 32 bits");
+
+static size_t mcsg_size(size_t n) {
+    return sizeof(mcsg_header_t) + 13 * n * sizeof(uint32_t) + 3 * n * n;
+}
+
+// Writes the .mcsg image of g at the current position of f
+static void write_mcsg(mcs_graph_t *g, FILE *f) {
+    mcs_graph_prepare(g);
+    int n = g->g->n;
+    mcsg_header_t h = { .version = MCSG_VERSION, .n = n, .hash = g->hash };
+    memcpy(h.magic, MCSG_MAGIC, sizeof h.magic);
+    unsigned int *twin = g->g->twin != NULL ? g->g->twin : calculate_twins(g->g);
+    graph_t *graphs[3] = { g->g, g->sorted[0], g->sorted[1] };
+    fwrite(&h, sizeof h, 1, f);
+    for (int k = 0; k < 3; k++) {
+        fwrite(graphs[k]->label, sizeof(uint32_t), n, f);
+        fwrite(graphs[k]->degree, sizeof(uint32_t), n, f);
+        fwrite(k == 0 ? twin : graphs[k]->twin, sizeof(uint32_t), n, f);
+    }
+    fwrite(g->order[0], sizeof(int32_t), n, f);
+    fwrite(g->order[1], sizeof(int32_t), n, f);
+    fwrite(g->canon, sizeof(int32_t), n, f);
+    fwrite(g->canon_pos, sizeof(int32_t), n, f);
+    for (int k = 0; k < 3; k++)
+        for (int i = 0; i < n; i++)
+            fwrite(graphs[k]->adjmat[i], 1, n, f);
+    if (twin != g->g->twin) free(twin);
+}
+
+int mcs_graph_write(mcs_graph_t *g, const char *filename) {
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) return -1;
+    write_mcsg(g, f);
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+static bool is_permutation(const int *a, int n, unsigned char *seen) {
+    memset(seen, 0, n);
+    for (int i = 0; i < n; i++) {
+        if (a[i] < 0 || a[i] >= n || seen[a[i]]) return false;
+        seen[a[i]] = 1;
+    }
+    return true;
+}
+
+// Nothing is copied or computed: the arrays are the .mcsg image at base,
+// and only the row pointers of the adjacency matrices are allocated. The
+// permutations are checked, since the search uses them as indices. NULL if
+// base does not hold an image of size bytes.
+static mcs_graph_t *view_graph(const void *base, size_t size) {
+    const mcsg_header_t *h = base;
+    if (size < sizeof *h || memcmp(h->magic, MCSG_MAGIC, sizeof h->magic) != 0
+            || h->version != MCSG_VERSION || h->n > INT_MAX || size != mcsg_size(h->n))
+        return NULL;
+    size_t n = h->n;
+
+    mcs_graph_t *g = calloc(1, sizeof *g);
+    g->view = true;
+    g->hash = h->hash;
+    unsigned int *u = (unsigned int *) (h + 1);
+    graph_t *graphs[3];
+    for (int k = 0; k < 3; k++) {
+        graphs[k] = calloc(1, sizeof *graphs[k]);
+        graphs[k]->n = n;
+        graphs[k]->label = u;
+        graphs[k]->degree = u + n;
+        graphs[k]->twin = u + 2 * n;
+        u += 3 * n;
+    }
+    int *perm = (int *) u;
+    g->order[0] = perm;
+    g->order[1] = perm + n;
+    g->canon = perm + 2 * n;
+    g->canon_pos = perm + 3 * n;
+    unsigned char *rows = (unsigned char *) (perm + 4 * n);
+    for (int k = 0; k < 3; k++) {
+        graphs[k]->adjmat = malloc(n * sizeof *graphs[k]->adjmat);
+        for (size_t i = 0; i < n; i++)
+            graphs[k]->adjmat[i] = rows + (k * n + i) * n;
+    }
+    g->g = graphs[0];
+    g->sorted[0] = graphs[1];
+    g->sorted[1] = graphs[2];
+
+    unsigned char *seen = malloc(n + 1);
+    bool ok = true;
+    for (int k = 0; k < 4; k++)
+        ok = ok && is_permutation(perm + k * n, n, seen);
+    for (int k = 0; k < 3; k++)
+        for (size_t i = 0; i < n; i++)
+            ok = ok && graphs[k]->twin[i] < n;
+    free(seen);
+    if (!ok) {
+        mcs_graph_free(g);
+        return NULL;
+    }
+    return g;
+}
+
+static mcs_graph_t *map_graph(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    mcs_graph_t *g = view_graph(map, st.st_size);
+    if (g == NULL) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    g->map = map;
+    g->map_size = st.st_size;
+    return g;
+}
+
+// SEARCH //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void search(mcs_solver_t *s) {
+    const problem_t *pb = &s->pb;
+    pool_t *pool = s->opt.engine == MCS_ENGINE_SEQUENTIAL ? NULL : s->pool;
+    uint bd_pos = 0, bd_n = 0;
+    uchar cur[MAX_GRAPH_SIZE][2];
+    uchar domains[MAX_DOMAINS][BDS];
+    uchar left[MAX_GRAPH_SIZE], right[MAX_GRAPH_SIZE];
+    uchar v, w, *bd;
+    initial_domains(pb, domains, &bd_pos, left, right);
+
+    if (pool != NULL)
+        reset_pool(pool, pb, s->opt.split_level, s->timeout, s->start, s->opt.connected, s->target);
+
+    while (bd_pos > 0) {
+        if (s->timeout && compute_elapsed_millisec(s->start) > s->timeout) {
+            s->timeout = -1;
+            break;
+        }
+        if (s->target && s->inc_pos >= s->target) {
+            break;
+        }
+
+        bd = &domains[bd_pos - 1][L];
+
+        if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] + (bd[RL] != bd[IRL]) <= s->inc_pos || (bd[LL] == 0 && bd[RL] == bd[IRL]))
+            bd_pos--;
+        else {
+            select_bidomain(domains, bd_pos, left, domains[bd_pos - 1][P], s->opt.connected);
+
+            if (pool != NULL && bd[P] == pool->level) {
+                if (fill_pool_args(pool, domains, cur, left, right, &bd_pos, bd_n, s->inc_pos))
+                    compute(pool, &s->inc_pos, s->incumbent);
+            } else {
+                v = select_next_v(left, bd);
+                if ((bd[W] = select_next_w(right, bd)) != UCHAR_MAX) {
+                    w = right[bd[R] + bd[W]];       // swap the W after the bottom of the current right domain
+                    right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
+                    right[bd[R] + bd[RL]] = w;
+                    bd[W] = w;                      // store the W used for this iteration
+                    if (twin_already_tried(pb, right, bd, w))
+                        continue;
+                    cur[bd[P]][L] = v;
+                    cur[bd[P]][R] = w;
+                    update_incumbent(cur, s->incumbent, bd[P] + (uchar) 1, &s->inc_pos, DEFAULT_THREADS);
+                    generate_next_domains(pb, domains, &bd_pos, bd[P] + 1, left, right, v, w, s->inc_pos);
+                } else
+                    remove_left_twins(pb, left, bd, v);
+            }
+        }
+    }
+    if (pool != NULL) {
+        if (s->timeout >= 0 && pool->n_th > 0 && !(s->target && s->inc_pos >= s->target))
+            compute(pool, &s->inc_pos, s->incumbent);
+        if (pool->timeout == -1)
+            s->timeout = -1;
+    }
+}
+
+// Decision version of search: is there a solution of size goal = min(n0,n1)-k?
+// The incumbent starts at goal-1, so the bound prunes aggressively from the
+// root, and the first goal reached is the optimum. Goals below the threshold
+// are not tried.
+static void search_k_down(mcs_solver_t *s) {
+    uchar min = MIN(s->pb.n0, s->pb.n1);
+    uint floor = s->opt.threshold > 0 ? s->opt.threshold : 1;
+    for (uint goal = min; goal >= floor; goal--) {
+        s->inc_pos = goal - 1;
+        s->target = goal;
+        search(s);
+        if (s->inc_pos == goal)
+            break;
+        s->inc_pos = 0;     // goal-1 was only a bound, there is no mapping of that size yet
+        if (s->timeout == -1)
+            break;
+        if (s->opt.verbose) printf("No solution of size %d\n", goal);
+    }
+    s->target = 0;
+}
+
+// Threshold version of search: a single k-down step with goal = threshold.
+static void search_at_least(mcs_solver_t *s) {
+    s->inc_pos = s->opt.threshold - 1;
+    s->target = s->opt.threshold;
+    search(s);
+    if (s->inc_pos < s->opt.threshold)
+        s->inc_pos = 0;     // threshold-1 was only a bound
+    s->target = 0;
+}
+
+// SOLVERS /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void mcs_default_options(mcs_options_t *opt) {
+    opt->engine = MCS_ENGINE_PARALLEL;
+    opt->timeout = 0;
+    opt->threshold = 0;
+    opt->connected = false;
+    opt->split_level = POOL_LEVEL;
+    opt->verbose = false;
+}
+
+mcs_solver_t *mcs_solver_create(unsigned int n_threads) {
+    if (n_threads > MAX_THREADS) return NULL;
+    mcs_solver_t *s = calloc(1, sizeof *s);
+    s->pool = n_threads > 0 ? init_pool(n_threads) : NULL;
+    return s;
+}
+
+// Returns whether g has an edge label other than 0, or an arc
+static bool load_graph(uchar adjmat[][MAX_GRAPH_SIZE], uchar *twin, uint *label, uchar *n, graph_t *g) {
+    bool edge_labelled = false;
+    *n = g->n;
+    for (int i = 0; i < g->n; i++) {
+        for (int j = 0; j < g->n; j++) {
+            adjmat[i][j] = g->adjmat[i][j];
+            edge_labelled |= adjmat[i][j] > 1;
+        }
+        twin[i] = g->twin[i];
+        label[i] = g->label[i];
+    }
+    return edge_labelled;
+}
+
+static void load_problem(problem_t *pb, graph_t *g0, graph_t *g1) {
+    bool labelled0 = load_graph(pb->adjmat0, pb->twin0, pb->label0, &pb->n0, g0);
+    bool labelled1 = load_graph(pb->adjmat1, pb->twin1, pb->label1, &pb->n1, g1);
+    pb->edge_labelled = labelled0 || labelled1;
+}
+
+// Loads the best known mapping of the pair as the incumbent, and returns
+// whether the cache settles the solve: for a threshold, the mapping reaches
+// it or the bound is below it, otherwise the mapping is proven optimal.
+static bool from_cache(mcs_solver_t *s, mcs_graph_t *g0, mcs_graph_t *g1, int k0, int k1) {
+    cache_entry_t known;
+    canonical(g0);
+    canonical(g1);
+    bool swapped = false;
+    if (!cache_lookup(s->cache, g0->hash, g1->hash, s->opt.connected, &known)) {
+        if (!cache_lookup(s->cache, g1->hash, g0->hash, s->opt.connected, &known))
+            return false;
+        swapped = true;
+    }
+    int a = swapped ? R : L, b = swapped ? L : R;
+    for (int i = 0; i < known.lower; i++)
+        if (known.map[i][a] >= s->pb.n0 || known.map[i][b] >= s->pb.n1)
+            return false;           // a hash collision
+    uchar pos0[MAX_GRAPH_SIZE], pos1[MAX_GRAPH_SIZE];
+    for (int i = 0; i < s->pb.n0; i++)
+        pos0[g0->order[k0][i]] = i;
+    for (int i = 0; i < s->pb.n1; i++)
+        pos1[g1->order[k1][i]] = i;
+    for (int i = 0; i < known.lower; i++) {
+        s->incumbent[i][L] = pos0[g0->canon[known.map[i][a]]];
+        s->incumbent[i][R] = pos1[g1->canon[known.map[i][b]]];
+    }
+    s->inc_pos = known.lower;
+
+    uint threshold = s->opt.threshold;
+    if (threshold == 0)
+        return known.lower == known.bound;
+    if (known.lower >= threshold)
+        return true;
+    if (known.bound >= 0 && known.bound < threshold) {
+        s->inc_pos = 0;
+        return true;
+    }
+    return false;
+}
+
+static void to_cache(mcs_solver_t *s, mcs_graph_t *g0, mcs_graph_t *g1, const mcs_result_t *res) {
+    canonical(g0);
+    canonical(g1);
+    cache_entry_t e = { .h0 = g0->hash, .h1 = g1->hash, .connected = s->opt.connected, .lower = res->size, .bound = -1 };
+    if (res->status == MCS_OPTIMAL)
+        e.bound = res->size;
+    else if (res->status == MCS_THRESHOLD_UNREACHABLE)
+        e.bound = s->opt.threshold - 1;
+    for (uint i = 0; i < res->size; i++) {
+        e.map[i][L] = g0->canon_pos[res->map[i][0]];
+        e.map[i][R] = g1->canon_pos[res->map[i][1]];
+    }
+    cache_store(s->cache, &e);
+}
+
+// mcs_solve, where the plain search only looks for common subgraphs larger
+// than floor: if there is none, the result is empty.
+static int solve(mcs_solver_t *s, mcs_graph_t *g0, mcs_graph_t *g1, const mcs_options_t *opt, uint floor, mcs_result_t *res) {
+    struct timespec finish;
+    res->size = 0;
+    res->time = 0;
+    res->cached = false;
+    if (g0->g->n > MAX_GRAPH_SIZE || g1->g->n > MAX_GRAPH_SIZE || opt->split_level >= MAX_GRAPH_SIZE
+            || opt->engine < MCS_ENGINE_PARALLEL || opt->engine > MCS_ENGINE_K_DOWN
+            || (opt->engine == MCS_ENGINE_PARALLEL && s->pool == NULL))
+        return res->status = MCS_ERROR;
+
+    // vertices are sorted by decreasing degree, or increasing if the other graph is dense
+    sorted_graph(g0, 0);
+    sorted_graph(g1, 0);
+    int k0 = graph_edge_count(g1->g) > g1->g->n * (g1->g->n - 1) / 2;
+    int k1 = graph_edge_count(g0->g) > g0->g->n * (g0->g->n - 1) / 2;
+    load_problem(&s->pb, sorted_graph(g0, k0), sorted_graph(g1, k1));
+
+    s->opt = *opt;
+    s->target = 0;
+    s->timeout = opt->timeout;
+    s->inc_pos = 0;
+    uint min = MIN(s->pb.n0, s->pb.n1);
+
+    clock_gettime(CLOCK_MONOTONIC, &s->start);
+    if (s->cache != NULL)
+        res->cached = from_cache(s, g0, g1, k0, k1);
+    if (res->cached)
+        ;
+    else if (opt->threshold > min)
+        s->inc_pos = 0;             // the root bound is min(n0,n1)
+    else if (opt->engine == MCS_ENGINE_K_DOWN)
+        search_k_down(s);
+    else if (opt->threshold)
+        search_at_least(s);
+    else {
+        s->inc_pos = floor;
+        search(s);
+        if (s->inc_pos == floor)
+            s->inc_pos = 0;         // floor was only a bound
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    res->time = (finish.tv_sec - s->start.tv_sec) + (double) (finish.tv_nsec - s->start.tv_nsec) / 1000000000.0;
+
+    res->size = s->inc_pos;
+    for (uint i = 0; i < s->inc_pos; i++) {
+        res->map[i][0] = g0->order[k0][s->incumbent[i][L]];
+        res->map[i][1] = g1->order[k1][s->incumbent[i][R]];
+    }
+    if (s->timeout == -1)
+        res->status = MCS_TIMEOUT;
+    else if (opt->threshold)
+        res->status = res->size >= opt->threshold ? MCS_THRESHOLD_REACHED : MCS_THRESHOLD_UNREACHABLE;
+    else
+        res->status = MCS_OPTIMAL;
+    if (s->cache != NULL && !res->cached)
+        to_cache(s, g0, g1, res);
+    return res->status;
+}
+
+int mcs_solve(mcs_solver_t *s, mcs_graph_t *g0, mcs_graph_t *g1, const mcs_options_t *opt, mcs_result_t *res) {
+    return solve(s, g0, g1, opt, 0, res);
+}
+
+bool mcs_check(const mcs_graph_t *g0, const mcs_graph_t *g1, const mcs_result_t *res) {
+    uchar sol[MCS_MAX_VERTICES][2];
+    for (uint i = 0; i < res->size; i++) {
+        sol[i][L] = res->map[i][0];
+        sol[i][R] = res->map[i][1];
+    }
+    return check_sol(g0->g, g1->g, sol, res->size);
+}
+
+const char *mcs_status_name(int status) {
+    switch (status) {
+        case MCS_OPTIMAL: return "optimal";
+        case MCS_THRESHOLD_REACHED: return "reached";
+        case MCS_THRESHOLD_UNREACHABLE: return "unreachable";
+        case MCS_TIMEOUT: return "timeout";
+        default: return "error";
+    }
+}
+
+void mcs_solver_set_cache(mcs_solver_t *s, mcs_cache_t *c) {
+    s->cache = c;
+}
+
+mcs_cache_t *mcs_cache_open(const char *filename) {
+    return cache_open(filename);
+}
+
+void mcs_cache_close(mcs_cache_t *c) {
+    cache_close(c);
+}
+
+void mcs_solver_free(mcs_solver_t *s) {
+    if (s->pool != NULL)
+        stop_pool(s->pool);
+    free(s);
+}
+
+// DATABASES ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void pad_to_8(FILE *f) {
+    static const char zeros[8];
+    long pos = ftell(f);
+    if (pos % 8 != 0) fwrite(zeros, 1, 8 - pos % 8, f);
+}
+
+int mcs_db_write(const char *filename, mcs_graph_t **graphs, const char **names, int n) {
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) return -1;
+    db_entry_t *entries = calloc(n, sizeof *entries);
+    db_header_t h = { .version = DB_VERSION, .count = n };
+    memcpy(h.magic, DB_MAGIC, sizeof h.magic);
+    for (int i = 0; i < n; i++) {
+        entries[i].name = h.names_size;
+        h.names_size += strlen(names[i]) + 1;
+    }
+    fwrite(&h, sizeof h, 1, f);
+    fwrite(entries, sizeof *entries, n, f);         // written again once the offsets are known
+    for (int i = 0; i < n; i++)
+        fwrite(names[i], 1, strlen(names[i]) + 1, f);
+    for (int i = 0; i < n; i++) {
+        graph_t *g = graphs[i]->g;
+        pad_to_8(f);
+        entries[i].offset = ftell(f);
+        write_mcsg(graphs[i], f);
+        entries[i].size = ftell(f) - entries[i].offset;
+        entries[i].n = g->n;
+        entries[i].m = graph_edge_count(g) / 2;
+        for (int v = 0; v < g->n; v++)
+            entries[i].labels[g->label[v] % MCS_DB_LABELS]++;
+    }
+    fseek(f, sizeof h, SEEK_SET);
+    fwrite(entries, sizeof *entries, n, f);
+    free(entries);
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+mcs_db_t *mcs_db_open(const char *filename) {
+    return db_open(filename);
+}
+
+int mcs_db_size(const mcs_db_t *db) {
+    return db->count;
+}
+
+int mcs_db_find(const mcs_db_t *db, const char *name) {
+    return db_find(db, name);
+}
+
+void mcs_db_entry(const mcs_db_t *db, int id, mcs_db_entry_t *e) {
+    const db_entry_t *de = &db->entries[id];
+    e->name = db->names + de->name;
+    e->n = de->n;
+    e->m = de->m;
+    e->labels = de->labels;
+}
+
+mcs_graph_t *mcs_db_graph(const mcs_db_t *db, int id) {
+    if (id < 0 || id >= db->count) return NULL;
+    const db_entry_t *e = &db->entries[id];
+    return view_graph((const char *) db->map + e->offset, e->size);
+}
+
+void mcs_db_close(mcs_db_t *db) {
+    db_close(db);
+}
+
+// ALL PAIRS ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every thread takes the next pair and solves it on its own. When no pair is
+// left, a running search that sees idle threads gives them the shallowest
+// level of its stack, i.e. all the branches of the oldest open node but the
+// one it is exploring, and keeps going deeper. The levels given away lie at
+// the bottom of the stack and are emptied in place, so the search pops them
+// without exploring them. All the threads working on a pair share the size
+// of its incumbent, which is all the matrix needs.
+
+typedef struct job_s {
+    problem_t pb;
+    int i, j;                       // the pair, with pb built from sorted_graph(graphs[i], k0) and sorted_graph(graphs[j], k1)
+    int k0, k1;
+    bool connected;
+    uint target;                    // as in mcs_solver_s
+    double timeout;
+    struct timespec start;
+    bool timed_out;
+
+    atomic_uint size;               // @suppress("Type cannot be resolved")
+
+    int pending;                    // levels given away and not solved yet, under the team mutex
+} job_t;
+
+typedef struct team_task_s {
+    task_data_t t;
+    job_t *job;
+    struct team_task_s *next;
+} team_task_t;
+
+typedef struct team_s {
+    mcs_graph_t **graphs;
+    const mcs_options_t *opt;
+    uint *sizes;
+    int *status;
+    int n;
+    int next_i, next_j;             // the next pair to start
+    int pairs_left;                 // pairs not finished yet
+
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+    team_task_t *tasks;
+    atomic_int idle, queued;        // @suppress("Type cannot be resolved")
+} team_t;
+
+static uint share_incumbent(job_t *job, uint len) {
+    uint size = atomic_load(&job->size); // @suppress("Type cannot be resolved")
+    while (len > size && !atomic_compare_exchange_weak(&job->size, &size, len)) // @suppress("Type cannot be resolved")
+        ;
+    return len > size ? len : size;
+}
+
+// Gives away the level of the stack starting at dead, unless it is the one
+// being expanded, and returns the new bottom of the live part of the stack.
+static uint give_level(team_t *team, job_t *job, uchar domains[][BDS], uint bd_pos, uint dead, const uchar *left, const uchar *right) {
+    uint end = dead;
+    uchar level = domains[dead][P];
+    while (end < bd_pos && domains[end][P] == level)
+        end++;
+    if (end == bd_pos)
+        return dead;
+    team_task_t *task = malloc(sizeof *task);
+    task->job = job;
+    task->t.bd_pos = end - dead;
+    memcpy(task->t.domains, domains + dead, (end - dead) * sizeof *domains);
+    memcpy(task->t.left, left, job->pb.n0);
+    memcpy(task->t.right, right, job->pb.n1);
+    for (uint i = dead; i < end; i++) {
+        domains[i][LL] = 0;
+        domains[i][RL] = domains[i][IRL];
+    }
+    pthread_mutex_lock(&team->mtx);
+    task->next = team->tasks;
+    team->tasks = task;
+    atomic_fetch_add(&team->queued, 1); // @suppress("Type cannot be resolved")
+    job->pending++;
+    pthread_cond_signal(&team->cv);
+    pthread_mutex_unlock(&team->mtx);
+    return end;
+}
+
+// The search loop of v4 on the stack in t.
+static void team_search(team_t *team, job_t *job, task_data_t *t) {
+    const problem_t *pb = &job->pb;
+    uchar (*domains)[BDS] = t->domains;
+    uchar *left = t->left, *right = t->right;
+    uint bd_pos = t->bd_pos, bd_n = 0, dead = 0, inc;
+    uchar v, w, *bd;
+
+    while (bd_pos > 0) {
+        if (dead > bd_pos)
+            dead = bd_pos;
+        if (job->timeout && compute_elapsed_millisec(job->start) > job->timeout) {
+            job->timed_out = true;
+            break;
+        }
+        inc = atomic_load(&job->size); // @suppress("Type cannot be resolved")
+        if (job->target && inc >= job->target)
+            break;
+        if (atomic_load(&team->idle) > atomic_load(&team->queued)) // @suppress("Type cannot be resolved")
+            dead = give_level(team, job, domains, bd_pos, dead, left, right);
+
+        bd = &domains[bd_pos - 1][L];
+
+        if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] + (bd[RL] != bd[IRL]) <= inc || (bd[LL] == 0 && bd[RL] == bd[IRL]))
+            bd_pos--;
+        else {
+            select_bidomain(domains, bd_pos, left, domains[bd_pos - 1][P], job->connected);
+            v = select_next_v(left, bd);
+            if ((bd[W] = select_next_w(right, bd)) != UCHAR_MAX) {
+                w = right[bd[R] + bd[W]];       // swap the W after the bottom of the current right domain
+                right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
+                right[bd[R] + bd[RL]] = w;
+                bd[W] = w;                      // store the W used for this iteration
+                if (twin_already_tried(pb, right, bd, w))
+                    continue;
+                if (bd[P] + 1u > inc)
+                    inc = share_incumbent(job, bd[P] + 1);
+                generate_next_domains(pb, domains, &bd_pos, bd[P] + 1, left, right, v, w, inc);
+            } else
+                remove_left_twins(pb, left, bd, v);
+        }
+    }
+}
+
+static void team_work(team_t *team, job_t *wait_for);
+
+static void solve_pair(team_t *team, int i, int j) {
+    mcs_graph_t *g0 = team->graphs[i], *g1 = team->graphs[j];
+    job_t *job = calloc(1, sizeof *job);
+    job->i = i;
+    job->j = j;
+    job->k0 = graph_edge_count(g1->g) > g1->g->n * (g1->g->n - 1) / 2;
+    job->k1 = graph_edge_count(g0->g) > g0->g->n * (g0->g->n - 1) / 2;
+    load_problem(&job->pb, g0->sorted[job->k0], g1->sorted[job->k1]);
+    job->connected = team->opt->connected;
+    job->target = team->opt->threshold;
+    job->timeout = team->opt->timeout;
+    atomic_init(&job->size, job->target > 0 ? job->target - 1 : 0); // @suppress("Type cannot be resolved")
+    clock_gettime(CLOCK_MONOTONIC, &job->start);
+
+    uint min = MIN(job->pb.n0, job->pb.n1);
+    if (job->target <= min) {
+        task_data_t *t = malloc(sizeof *t);
+        t->bd_pos = 0;
+        initial_domains(&job->pb, t->domains, &t->bd_pos, t->left, t->right);
+        team_search(team, job, t);
+        free(t);
+        team_work(team, job);
+    }
+
+    uint size = job->size >= job->target ? job->size : 0;   // below the target it was only a bound
+    int status = job->timed_out ? MCS_TIMEOUT
+            : job->target ? (size >= job->target ? MCS_THRESHOLD_REACHED : MCS_THRESHOLD_UNREACHABLE)
+            : MCS_OPTIMAL;
+    team->sizes[i * team->n + j] = team->sizes[j * team->n + i] = size;
+    if (team->status != NULL)
+        team->status[i * team->n + j] = team->status[j * team->n + i] = status;
+    free(job);
+
+    pthread_mutex_lock(&team->mtx);
+    if (--team->pairs_left == 0)
+        pthread_cond_broadcast(&team->cv);
+    pthread_mutex_unlock(&team->mtx);
+}
+
+// Takes pairs, then levels given away by other threads, until all the pairs
+// are solved. With wait_for, only takes levels, until those of wait_for are
+// solved.
+static void team_work(team_t *team, job_t *wait_for) {
+    pthread_mutex_lock(&team->mtx);
+    while (wait_for != NULL ? wait_for->pending > 0 : team->pairs_left > 0) {
+        if (wait_for == NULL && team->next_i < team->n - 1) {
+            int i = team->next_i, j = team->next_j;
+            if (++team->next_j == team->n) {
+                team->next_i++;
+                team->next_j = team->next_i + 1;
+            }
+            pthread_mutex_unlock(&team->mtx);
+            solve_pair(team, i, j);
+            pthread_mutex_lock(&team->mtx);
+        } else if (team->tasks != NULL) {
+            team_task_t *task = team->tasks;
+            team->tasks = task->next;
+            atomic_fetch_sub(&team->queued, 1); // @suppress("Type cannot be resolved")
+            pthread_mutex_unlock(&team->mtx);
+            team_search(team, task->job, &task->t);
+            pthread_mutex_lock(&team->mtx);
+            if (--task->job->pending == 0)
+                pthread_cond_broadcast(&team->cv);
+            free(task);
+        } else {
+            atomic_fetch_add(&team->idle, 1); // @suppress("Type cannot be resolved")
+            pthread_cond_wait(&team->cv, &team->mtx);
+            atomic_fetch_sub(&team->idle, 1); // @suppress("Type cannot be resolved")
+        }
+    }
+    pthread_mutex_unlock(&team->mtx);
+}
+
+static void *team_thread(void *arg) {
+    team_work((team_t *) arg, NULL);
+    return NULL;
+}
+
+int mcs_solve_all(mcs_graph_t **graphs, int n, unsigned int n_threads, const mcs_options_t *opt, unsigned int *sizes, int *status) {
+    if (n_threads == 0)
+        return MCS_ERROR;
+    for (int i = 0; i < n; i++)
+        if (graphs[i]->g->n > MAX_GRAPH_SIZE)
+            return MCS_ERROR;
+    for (int i = 0; i < n; i++) {
+        mcs_graph_prepare(graphs[i]);
+        sizes[i * n + i] = graphs[i]->g->n;
+        if (status != NULL)
+            status[i * n + i] = !opt->threshold ? MCS_OPTIMAL
+                    : graphs[i]->g->n >= opt->threshold ? MCS_THRESHOLD_REACHED : MCS_THRESHOLD_UNREACHABLE;
+    }
+
+    team_t team = { .graphs = graphs, .opt = opt, .sizes = sizes, .status = status, .n = n,
+                    .next_i = 0, .next_j = 1, .pairs_left = n * (n - 1) / 2, .tasks = NULL };
+    pthread_mutex_init(&team.mtx, NULL);
+    pthread_cond_init(&team.cv, NULL);
+    atomic_init(&team.idle, 0); // @suppress("Type cannot be resolved")
+    atomic_init(&team.queued, 0); // @suppress("Type cannot be resolved")
+    pthread_t threads[n_threads];
+    for (uint t = 1; t < n_threads; t++)
+        pthread_create(&threads[t], NULL, team_thread, &team);
+    team_work(&team, NULL);
+    for (uint t = 1; t < n_threads; t++)
+        pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&team.mtx);
+    pthread_cond_destroy(&team.cv);
+    return 0;
+}
+
+// BOUNDS //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void mcs_bounds(mcs_graph_t *g0, mcs_graph_t *g1, bool connected, mcs_bounds_t *b) {
+    sorted_graph(g0, 0);
+    sorted_graph(g1, 0);
+    compute_bounds(g0->g, g1->g, connected, b);
+}
+
+// QUERIES /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The candidates are ranked by their cheap bound and handed out in that
+// order, so when the next one cannot beat the k-th match, neither can any of
+// the following. The search for a candidate only looks for subgraphs larger
+// than the k-th match at the time it is handed out: a match of the same size
+// found later cannot rank above it, as it comes later in the order.
+
+typedef struct candidate_s {
+    int id;
+    uint bound;
+} candidate_t;
+
+typedef struct query_s {
+    mcs_graph_t *query;
+    const mcs_db_t *db;
+    const mcs_options_t *opt;
+    candidate_t *cand;
+    int n_cand, next;
+    mcs_match_t *top;               // by decreasing size, then by rank
+    int *rank;                      // of each match in top
+    int k, n_top;
+    int solved;
+    pthread_mutex_t mtx;
+} query_t;
+
+static int by_bound(const void *a, const void *b) {
+    const candidate_t *x = a, *y = b;
+    if (x->bound != y->bound) return x->bound < y->bound ? 1 : -1;
+    return x->id - y->id;
+}
+
+// Vertices of equal label can only be matched to each other, so a common
+// subgraph has at most min(count0[l], count1[l]) vertices of label l.
+static uint label_count_bound(const uint *count0, const uint *count1) {
+    uint bound = 0;
+    for (int l = 0; l < MCS_DB_LABELS; l++)
+        bound += MIN(count0[l], count1[l]);
+    return bound;
+}
+
+static bool ranks_above(const query_t *q, int i, int rank, const mcs_match_t *m) {
+    return q->top[i].size > m->size || (q->top[i].size == m->size && q->rank[i] < rank);
+}
+
+static void add_match(query_t *q, int rank, const mcs_match_t *m) {
+    if (q->n_top == q->k && ranks_above(q, q->k - 1, rank, m))
+        return;
+    int i = q->n_top < q->k ? q->n_top++ : q->k - 1;
+    while (i > 0 && !ranks_above(q, i - 1, rank, m)) {
+        q->top[i] = q->top[i - 1];
+        q->rank[i] = q->rank[i - 1];
+        i--;
+    }
+    q->top[i] = *m;
+    q->rank[i] = rank;
+}
+
+static void *query_thread(void *arg) {
+    query_t *q = arg;
+    mcs_solver_t *s = mcs_solver_create(0);
+    mcs_options_t opt = *q->opt;
+    opt.engine = MCS_ENGINE_SEQUENTIAL;
+    opt.threshold = 0;
+    mcs_result_t res;
+    for (;;) {
+        pthread_mutex_lock(&q->mtx);
+        uint floor = q->n_top == q->k ? q->top[q->k - 1].size : 0;
+        if (q->next == q->n_cand || (q->n_top == q->k && q->cand[q->next].bound <= floor)) {
+            pthread_mutex_unlock(&q->mtx);
+            break;
+        }
+        int rank = q->next++;
+        pthread_mutex_unlock(&q->mtx);
+
+        mcs_graph_t *g = mcs_db_graph(q->db, q->cand[rank].id);
+        if (g == NULL || g->g->n > MAX_GRAPH_SIZE) {
+            if (g != NULL) mcs_graph_free(g);
+            continue;
+        }
+        solve(s, q->query, g, &opt, floor, &res);
+        mcs_graph_free(g);
+        mcs_match_t m = { .id = q->cand[rank].id, .size = res.size, .bound = q->cand[rank].bound, .status = res.status };
+        pthread_mutex_lock(&q->mtx);
+        q->solved++;
+        if (res.size > floor || floor == 0)
+            add_match(q, rank, &m);
+        pthread_mutex_unlock(&q->mtx);
+    }
+    mcs_solver_free(s);
+    return NULL;
+}
+
+int mcs_query(mcs_graph_t *query, const mcs_db_t *db, int k, unsigned int n_threads, const mcs_options_t *opt, mcs_match_t *top, int *solved) {
+    if (k <= 0 || n_threads == 0 || n_threads > MAX_THREADS || query->g->n > MAX_GRAPH_SIZE)
+        return MCS_ERROR;
+    mcs_graph_prepare(query);
+    uint count[MCS_DB_LABELS] = { 0 };
+    for (int v = 0; v < query->g->n; v++)
+        count[query->g->label[v] % MCS_DB_LABELS]++;
+
+    query_t q = { .query = query, .db = db, .opt = opt, .top = top, .k = k };
+    q.cand = malloc(db->count * sizeof *q.cand);
+    q.rank = malloc(k * sizeof *q.rank);
+    for (int i = 0; i < db->count; i++) {
+        const db_entry_t *e = &db->entries[i];
+        uint min = MIN((uint) query->g->n, e->n), labels = label_count_bound(count, e->labels);
+        uint bound = MIN(min, labels);
+        mcs_graph_t *g = mcs_db_graph(db, i);
+        if (g != NULL) {
+            // the degrees of sorted[0] are non-increasing
+            uint degrees = degree_bound(query->sorted[0]->degree, query->g->n, g->sorted[0]->degree, g->g->n, opt->connected);
+            bound = MIN(bound, degrees);
+            mcs_graph_free(g);
+        }
+        q.cand[i].id = i;
+        q.cand[i].bound = bound;
+    }
+    qsort(q.cand, db->count, sizeof *q.cand, by_bound);
+    q.n_cand = db->count;
+    pthread_mutex_init(&q.mtx, NULL);
+    pthread_t threads[n_threads];
+    for (uint t = 1; t < n_threads; t++)
+        pthread_create(&threads[t], NULL, query_thread, &q);
+    query_thread(&q);
+    for (uint t = 1; t < n_threads; t++)
+        pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&q.mtx);
+    free(q.cand);
+    free(q.rank);
+    if (solved != NULL) *solved = q.solved;
+    return q.n_top;
+}
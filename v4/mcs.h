@@ -0,0 +1,222 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+// libmcs: the search of v4 as a library. Graphs are built in memory or read
+// from file, and a solver keeps its thread pool and buffers alive across any
+// number of solves. Solvers share no state, so each thread of the caller can
+// run its own; a graph can be shared by several solvers at once after
+// mcs_graph_prepare.
+
+#ifndef TRIMBLE_IT_MULTI_MCS_H
+#define TRIMBLE_IT_MULTI_MCS_H
+
+#include <stdbool.h>
+
+#define MCS_MAX_VERTICES 64
+#define MCS_MAX_VERTEX_LABEL 0x7fffffff
+#define MCS_MAX_EDGE_LABEL 254
+#define MCS_MAX_ARC_LABEL 14
+#define MCSG_MAGIC "MCSG"
+#define MCS_DEFAULT_THREADS 8
+
+#define MCS_ENGINE_PARALLEL   0     // subtrees at the split level are solved by the thread pool
+#define MCS_ENGINE_SEQUENTIAL 1     // the same search on the calling thread only
+#define MCS_ENGINE_K_DOWN     2     // decision searches for min(n0,n1), min(n0,n1)-1, ... on the pool
+
+#define MCS_OPTIMAL               0 // size is the maximum
+#define MCS_THRESHOLD_REACHED     1 // size is at least the threshold
+#define MCS_THRESHOLD_UNREACHABLE 2 // there is no common subgraph as large as the threshold
+#define MCS_TIMEOUT               3 // size is the best found before the timeout
+#define MCS_ERROR                -1 // a graph is larger than MCS_MAX_VERTICES or an option is out of range
+
+typedef struct mcs_graph_s mcs_graph_t;
+typedef struct mcs_solver_s mcs_solver_t;
+typedef struct mcs_cache_s mcs_cache_t;
+typedef struct mcs_db_s mcs_db_t;
+
+typedef struct mcs_options_s {
+    int engine;
+    double timeout;                 // seconds, 0 for none
+    unsigned int threshold;         // stop at the first common subgraph of this size, 0 for the maximum
+    bool connected;
+    unsigned int split_level;       // depth at which subtrees are handed to the pool
+    bool verbose;
+} mcs_options_t;
+
+typedef struct mcs_result_s {
+    int status;
+    unsigned int size;
+    unsigned int map[MCS_MAX_VERTICES][2];  // (vertex of g0, vertex of g1), numbered as in the graphs given
+    double time;                    // seconds
+    bool cached;                    // answered from the cache
+} mcs_result_t;
+
+// GRAPHS //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+mcs_graph_t *mcs_graph_create(int n);
+
+#define MCS_GRAPH_DIRECTED 1        // edges are arcs, from the vertex to its neighbours
+#define MCS_GRAPH_LABELLED 2        // keep the vertex and edge labels of binary files
+
+// format is 'B' (binary) or 'L' (LAD), flags a combination of the above;
+// files written by mcs_graph_write are recognised whatever the format and
+// mapped instead. NULL if the file cannot be opened or read, the reason
+// being written to stderr, or is a .mcsg file of another version or size.
+mcs_graph_t *mcs_graph_read(const char *filename, char format, int flags);
+
+void mcs_graph_add_edge(mcs_graph_t *g, int v, int w);
+
+// An arc from v to w, with a label up to MCS_MAX_ARC_LABEL. A common subgraph
+// of directed graphs matches arcs with arcs of the same direction, and two
+// opposite arcs with two opposite arcs. A graph has either edges or arcs.
+void mcs_graph_add_arc(mcs_graph_t *g, int v, int w, unsigned int label);
+
+// A common subgraph only matches vertices of equal label, and edges of equal
+// label. Vertices and edges start with label 0; labels out of range are
+// ignored.
+void mcs_graph_add_labelled_edge(mcs_graph_t *g, int v, int w, unsigned int label);
+
+void mcs_graph_set_label(mcs_graph_t *g, int v, unsigned int label);
+
+int mcs_graph_size(const mcs_graph_t *g);
+
+// Sorts the vertices by degree in both orders and computes the canonical
+// numbering, which mcs_solve otherwise does on first use. Edges must not be
+// added afterwards.
+void mcs_graph_prepare(mcs_graph_t *g);
+
+void mcs_graph_free(mcs_graph_t *g);
+
+// Writes g, prepared, to filename in the .mcsg format: the sorted graphs,
+// degrees, twins, permutations and canonical form, as mcs_graph_read maps
+// them with no parsing or preprocessing. A mapped graph is read-only and
+// the add functions ignore it. Returns 0, or -1 if the file cannot be
+// written.
+int mcs_graph_write(mcs_graph_t *g, const char *filename);
+
+// SOLVERS /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void mcs_default_options(mcs_options_t *opt);
+
+// n_threads = 0 gives a solver without pool, which runs every engine but
+// MCS_ENGINE_PARALLEL on the calling thread
+mcs_solver_t *mcs_solver_create(unsigned int n_threads);
+
+// Returns res->status
+int mcs_solve(mcs_solver_t *s, mcs_graph_t *g0, mcs_graph_t *g1, const mcs_options_t *opt, mcs_result_t *res);
+
+bool mcs_check(const mcs_graph_t *g0, const mcs_graph_t *g1, const mcs_result_t *res);
+
+// "optimal", "reached", "unreachable", "timeout" or "error"
+const char *mcs_status_name(int status);
+
+void mcs_solver_free(mcs_solver_t *s);
+
+// BOUNDS //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bounds on the size of the maximum common subgraph that need no search: the
+// upper bounds take O(n log n) time once the graphs are read, the greedy
+// lower bound O(n0 n1 size). A pair whose upper bound is below what is needed
+// can be discarded, and one whose lower bound is enough needs no search.
+
+typedef struct mcs_bounds_s {
+    unsigned int lower;             // size of a common subgraph found greedily
+    unsigned int upper;             // the smallest of the following
+    unsigned int size_bound;        // min(n0, n1)
+    unsigned int label_bound;       // sum over the labels of the smaller number of vertices with that label
+    unsigned int degree_bound;      // from the degree sequences (see bounds.h)
+} mcs_bounds_t;
+
+void mcs_bounds(mcs_graph_t *g0, mcs_graph_t *g1, bool connected, mcs_bounds_t *b);
+
+// CACHE ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A file of results keyed by the canonical hashes of the two graphs and by the
+// connected option (see canonical_form for which copies of a pair share an
+// entry).
+// Each entry keeps the largest common subgraph found and the best proven
+// bound, from any number of runs, timed out ones included. It can be shared
+// by solvers in different threads and by different processes.
+
+// Opens, or creates, filename; NULL if it cannot be opened
+mcs_cache_t *mcs_cache_open(const char *filename);
+
+// The solves of s are answered from c when it has the result, start from the
+// mapping of c otherwise, and store what they find in c. NULL detaches it.
+void mcs_solver_set_cache(mcs_solver_t *s, mcs_cache_t *c);
+
+void mcs_cache_close(mcs_cache_t *c);
+
+// ALL PAIRS ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Solves every pair of graphs[0 .. n-1] on n_threads threads and writes the
+// sizes to the n x n matrix sizes, and the statuses to status unless it is
+// NULL. The pairs are first solved one per thread; once none is left, the
+// threads that become idle join the searches still running. Only the timeout,
+// threshold and connected options are used; the timeout applies to each pair.
+int mcs_solve_all(mcs_graph_t **graphs, int n, unsigned int n_threads, const mcs_options_t *opt, unsigned int *sizes, int *status);
+
+// DATABASES ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A database is a single file holding many graphs as .mcsg images, with an
+// index of their names, sizes and label counts. It is mapped once, and then
+// any graph is fetched by id or name with no system call.
+
+#define MCS_DB_LABELS 16
+
+typedef struct mcs_db_entry_s {
+    const char *name;
+    int n, m;                       // vertices and edges
+    const unsigned int *labels;     // MCS_DB_LABELS counts, label l is counted in labels[l % MCS_DB_LABELS]
+} mcs_db_entry_t;
+
+// Writes graphs[0 .. n-1], prepared, under the given names; 0, or -1 if the
+// file cannot be written
+int mcs_db_write(const char *filename, mcs_graph_t **graphs, const char **names, int n);
+
+// NULL if filename cannot be opened or is not a database
+mcs_db_t *mcs_db_open(const char *filename);
+
+int mcs_db_size(const mcs_db_t *db);
+
+// Id of the first graph called name, -1 if there is none
+int mcs_db_find(const mcs_db_t *db, const char *name);
+
+// Precondition: 0 <= id < mcs_db_size(db)
+void mcs_db_entry(const mcs_db_t *db, int id, mcs_db_entry_t *e);
+
+// A read-only graph whose arrays are in the database, to be freed with
+// mcs_graph_free before db is closed; NULL if id is out of range or its image
+// is corrupt. Graphs of the same database can be used by different threads.
+mcs_graph_t *mcs_db_graph(const mcs_db_t *db, int id);
+
+void mcs_db_close(mcs_db_t *db);
+
+// QUERIES /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+typedef struct mcs_match_s {
+    int id;                         // in the database
+    unsigned int size;              // of the maximum common subgraph with the query
+    unsigned int bound;             // the cheap upper bound the graph was ranked by
+    int status;                     // MCS_OPTIMAL, or MCS_TIMEOUT if size is only the best found
+} mcs_match_t;
+
+// Writes to top the k graphs of db with the largest common subgraph with
+// query, by decreasing size, and returns how many were found, or MCS_ERROR.
+// The graphs are ranked by cheap upper bounds (sizes, label counts and
+// degrees, see mcs_bounds) and solved in that order on n_threads threads;
+// the ones whose bound cannot beat the k-th match so far are skipped.
+// solved, unless NULL, gets the number of graphs searched. Only the timeout
+// and connected options are used; the timeout applies to each graph. Graphs
+// larger than MCS_MAX_VERTICES are skipped.
+int mcs_query(mcs_graph_t *query, const mcs_db_t *db, int k, unsigned int n_threads, const mcs_options_t *opt, mcs_match_t *top, int *solved);
+
+#endif //TRIMBLE_IT_MULTI_MCS_H
@@ -0,0 +1,417 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+// One request per line, one reply line per request:
+//
+//   load NAME FILE                 ok NAME N
+//   graph NAME N V W V W ...       ok NAME N         the edges V-W, or arcs with -i, are given inline
+//   drop NAME                      ok NAME
+//   solve ID NAME0 NAME1 [timeout=SEC] [threshold=K] [connected] [k-down]
+//                                  ID SIZE STATUS TIME LATENCY V:W V:W ...
+//
+// Failed requests are answered with "error MESSAGE", or "ID error MESSAGE":
+// files that cannot be read, and graphs larger than MCS_MAX_VERTICES, are
+// refused without affecting the other requests.
+// Graphs are kept by name by the server and shared by all the clients. Solves
+// are queued to the worker threads, each with its own solver, and answered as
+// they finish, so replies may come out of order. The timeout of a solve counts
+// from its arrival, and LATENCY is the time from its arrival to its reply.
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "server.h"
+
+#define REGISTRY_BUCKETS 1024
+#define REPLY_SIZE 4096
+
+typedef struct entry_s {
+    char *name;
+    mcs_graph_t *g;
+    int refs;                       // one for the registry, one for each queued solve
+    struct entry_s *next;
+} entry_t;
+
+typedef struct connection_s {
+    FILE *in;
+    int out;
+    pthread_mutex_t out_mtx;
+    int refs;                       // one for the reader, one for each queued solve
+} connection_t;
+
+typedef struct request_s {
+    connection_t *conn;
+    char id[64];
+    entry_t *g0, *g1;
+    mcs_options_t opt;
+    struct timespec arrival;
+    struct request_s *next;
+} request_t;
+
+static entry_t *registry[REGISTRY_BUCKETS];
+static pthread_mutex_t registry_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static request_t *queue_head, *queue_tail;
+static bool queue_closed;
+static pthread_mutex_t queue_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cv = PTHREAD_COND_INITIALIZER;
+
+static char graph_format;
+static int graph_flags;
+static mcs_options_t default_options;
+static mcs_cache_t *result_cache;
+
+static double elapsed_since(struct timespec start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (double) (now.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+// CONNECTIONS /////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void reply(connection_t *c, const char *fmt, ...) {
+    char line[REPLY_SIZE];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof line - 1, fmt, ap);
+    va_end(ap);
+    if (len > (int) sizeof line - 2) len = sizeof line - 2;
+    line[len++] = '\n';
+    pthread_mutex_lock(&c->out_mtx);
+    if (write(c->out, line, len) < 0) { }     // the client is gone, its requests are still served
+    pthread_mutex_unlock(&c->out_mtx);
+}
+
+static void release_connection(connection_t *c) {
+    pthread_mutex_lock(&c->out_mtx);
+    bool last = --c->refs == 0;
+    pthread_mutex_unlock(&c->out_mtx);
+    if (last) {
+        if (c->in != stdin) fclose(c->in);
+        pthread_mutex_destroy(&c->out_mtx);
+        free(c);
+    }
+}
+
+// REGISTRY ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static entry_t **bucket_of(const char *name) {
+    unsigned int h = 2166136261u;   // FNV-1a
+    for (const char *c = name; *c; c++)
+        h = (h ^ (unsigned char) *c) * 16777619u;
+    return &registry[h % REGISTRY_BUCKETS];
+}
+
+// Called with registry_mtx held
+static void release_entry(entry_t *e) {
+    if (--e->refs == 0) {
+        mcs_graph_free(e->g);
+        free(e->name);
+        free(e);
+    }
+}
+
+static void unregister(const char *name) {
+    for (entry_t **p = bucket_of(name); *p != NULL; p = &(*p)->next)
+        if (strcmp((*p)->name, name) == 0) {
+            entry_t *e = *p;
+            *p = e->next;
+            release_entry(e);
+            return;
+        }
+}
+
+// Takes g, already prepared, and replaces any graph with the same name
+static void register_graph(const char *name, mcs_graph_t *g) {
+    entry_t *e = malloc(sizeof *e);
+    e->name = strdup(name);
+    e->g = g;
+    e->refs = 1;
+    pthread_mutex_lock(&registry_mtx);
+    unregister(name);
+    entry_t **bucket = bucket_of(name);
+    e->next = *bucket;
+    *bucket = e;
+    pthread_mutex_unlock(&registry_mtx);
+}
+
+static entry_t *acquire(const char *name) {
+    pthread_mutex_lock(&registry_mtx);
+    entry_t *e = *bucket_of(name);
+    while (e != NULL && strcmp(e->name, name) != 0)
+        e = e->next;
+    if (e != NULL) e->refs++;
+    pthread_mutex_unlock(&registry_mtx);
+    return e;
+}
+
+static void release(entry_t *e) {
+    pthread_mutex_lock(&registry_mtx);
+    release_entry(e);
+    pthread_mutex_unlock(&registry_mtx);
+}
+
+// WORKERS /////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void push_request(request_t *r) {
+    pthread_mutex_lock(&queue_mtx);
+    r->next = NULL;
+    if (queue_tail != NULL) queue_tail->next = r;
+    else queue_head = r;
+    queue_tail = r;
+    pthread_cond_signal(&queue_cv);
+    pthread_mutex_unlock(&queue_mtx);
+}
+
+// NULL once the queue is closed and empty
+static request_t *pop_request() {
+    pthread_mutex_lock(&queue_mtx);
+    while (queue_head == NULL && !queue_closed)
+        pthread_cond_wait(&queue_cv, &queue_mtx);
+    request_t *r = queue_head;
+    if (r != NULL) {
+        queue_head = r->next;
+        if (queue_head == NULL) queue_tail = NULL;
+    }
+    pthread_mutex_unlock(&queue_mtx);
+    return r;
+}
+
+static void *worker(void *arg) {
+    mcs_solver_t *solver = mcs_solver_create(0);
+    mcs_solver_set_cache(solver, result_cache);
+    mcs_result_t res;
+    request_t *r;
+    char map[REPLY_SIZE];
+    while ((r = pop_request()) != NULL) {
+        double waited = elapsed_since(r->arrival);
+        if (r->opt.timeout > 0 && waited >= r->opt.timeout) {
+            res.status = MCS_TIMEOUT;
+            res.size = 0;
+            res.time = 0;
+        } else {
+            if (r->opt.timeout > 0) r->opt.timeout -= waited;
+            mcs_solve(solver, r->g0->g, r->g1->g, &r->opt, &res);
+        }
+        if (res.status == MCS_ERROR)
+            reply(r->conn, "%s error graphs larger than %d vertices", r->id, MCS_MAX_VERTICES);
+        else {
+            int len = 0;
+            map[0] = '\0';
+            for (unsigned int i = 0; i < res.size; i++)
+                len += snprintf(map + len, sizeof map - len, " %u:%u", res.map[i][0], res.map[i][1]);
+            reply(r->conn, "%s %u %s %.6f %.6f%s", r->id, res.size, mcs_status_name(res.status), res.time,
+                    elapsed_since(r->arrival), map);
+        }
+        release(r->g0);
+        release(r->g1);
+        release_connection(r->conn);
+        free(r);
+    }
+    mcs_solver_free(solver);
+    return NULL;
+}
+
+// REQUESTS ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void request_solve(connection_t *c, char **save, struct timespec arrival) {
+    char *id = strtok_r(NULL, " \t\r\n", save);
+    char *name0 = strtok_r(NULL, " \t\r\n", save);
+    char *name1 = strtok_r(NULL, " \t\r\n", save);
+    if (name1 == NULL) {
+        reply(c, "error usage: solve ID NAME0 NAME1 [timeout=SEC] [threshold=K] [connected] [k-down]");
+        return;
+    }
+    request_t *r = malloc(sizeof *r);
+    snprintf(r->id, sizeof r->id, "%s", id);
+    r->opt = default_options;
+    r->opt.engine = MCS_ENGINE_SEQUENTIAL;
+    r->arrival = arrival;
+    for (char *t; (t = strtok_r(NULL, " \t\r\n", save)) != NULL; ) {
+        if (strncmp(t, "timeout=", 8) == 0) r->opt.timeout = strtod(t + 8, NULL);
+        else if (strncmp(t, "threshold=", 10) == 0) r->opt.threshold = strtol(t + 10, NULL, 10);
+        else if (strcmp(t, "connected") == 0) r->opt.connected = true;
+        else if (strcmp(t, "k-down") == 0) r->opt.engine = MCS_ENGINE_K_DOWN;
+        else {
+            reply(c, "%s error unknown option %s", r->id, t);
+            free(r);
+            return;
+        }
+    }
+    r->g0 = acquire(name0);
+    r->g1 = acquire(name1);
+    if (r->g0 == NULL || r->g1 == NULL) {
+        reply(c, "%s error unknown graph %s", r->id, r->g0 == NULL ? name0 : name1);
+        if (r->g0 != NULL) release(r->g0);
+        if (r->g1 != NULL) release(r->g1);
+        free(r);
+        return;
+    }
+    r->conn = c;
+    pthread_mutex_lock(&c->out_mtx);
+    c->refs++;
+    pthread_mutex_unlock(&c->out_mtx);
+    push_request(r);
+}
+
+static void request_graph(connection_t *c, char **save) {
+    char *name = strtok_r(NULL, " \t\r\n", save);
+    char *n_text = strtok_r(NULL, " \t\r\n", save);
+    int n = n_text != NULL ? strtol(n_text, NULL, 10) : -1;
+    if (n < 0) {
+        reply(c, "error usage: graph NAME N V W V W ...");
+        return;
+    }
+    // no client gets n*n bytes allocated for a graph that cannot be solved
+    if (n > MCS_MAX_VERTICES) {
+        reply(c, "error graph %s larger than %d vertices", name, MCS_MAX_VERTICES);
+        return;
+    }
+    mcs_graph_t *g = mcs_graph_create(n);
+    for (char *v; (v = strtok_r(NULL, " \t\r\n", save)) != NULL; ) {
+        char *w = strtok_r(NULL, " \t\r\n", save);
+        int a = strtol(v, NULL, 10), b = w != NULL ? strtol(w, NULL, 10) : -1;
+        if (a < 0 || a >= n || b < 0 || b >= n) {
+            reply(c, "error bad edge in graph %s", name);
+            mcs_graph_free(g);
+            return;
+        }
+        if (graph_flags & MCS_GRAPH_DIRECTED)
+            mcs_graph_add_arc(g, a, b, 0);
+        else
+            mcs_graph_add_edge(g, a, b);
+    }
+    mcs_graph_prepare(g);
+    register_graph(name, g);
+    reply(c, "ok %s %d", name, n);
+}
+
+static void handle_line(connection_t *c, char *line) {
+    struct timespec arrival;
+    clock_gettime(CLOCK_MONOTONIC, &arrival);
+    char *save;
+    char *cmd = strtok_r(line, " \t\r\n", &save);
+    if (cmd == NULL)
+        return;
+    if (strcmp(cmd, "solve") == 0)
+        request_solve(c, &save, arrival);
+    else if (strcmp(cmd, "graph") == 0)
+        request_graph(c, &save);
+    else if (strcmp(cmd, "load") == 0) {
+        char *name = strtok_r(NULL, " \t\r\n", &save);
+        char *filename = strtok_r(NULL, " \t\r\n", &save);
+        mcs_graph_t *g = filename != NULL ? mcs_graph_read(filename, graph_format, graph_flags) : NULL;
+        if (g == NULL) {
+            reply(c, "error cannot read %s", filename != NULL ? filename : "");
+            return;
+        }
+        if (mcs_graph_size(g) > MCS_MAX_VERTICES) {
+            reply(c, "error graph %s larger than %d vertices", name, MCS_MAX_VERTICES);
+            mcs_graph_free(g);
+            return;
+        }
+        mcs_graph_prepare(g);
+        register_graph(name, g);
+        reply(c, "ok %s %d", name, mcs_graph_size(g));
+    } else if (strcmp(cmd, "drop") == 0) {
+        char *name = strtok_r(NULL, " \t\r\n", &save);
+        if (name == NULL) {
+            reply(c, "error usage: drop NAME");
+            return;
+        }
+        pthread_mutex_lock(&registry_mtx);
+        unregister(name);
+        pthread_mutex_unlock(&registry_mtx);
+        reply(c, "ok %s", name);
+    } else
+        reply(c, "error unknown request %s", cmd);
+}
+
+static void serve_connection(connection_t *c) {
+    char *line = NULL;
+    size_t size = 0;
+    while (getline(&line, &size, c->in) != -1)
+        handle_line(c, line);
+    free(line);
+    release_connection(c);
+}
+
+static void *connection_thread(void *arg) {
+    serve_connection((connection_t *) arg);
+    return NULL;
+}
+
+static connection_t *new_connection(FILE *in, int out) {
+    connection_t *c = malloc(sizeof *c);
+    c->in = in;
+    c->out = out;
+    c->refs = 1;
+    pthread_mutex_init(&c->out_mtx, NULL);
+    return c;
+}
+
+// SERVER //////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int run_server(const char *path, unsigned int n_workers, char format, int flags, const mcs_options_t *defaults, mcs_cache_t *cache) {
+    graph_format = format;
+    graph_flags = flags;
+    default_options = *defaults;
+    result_cache = cache;
+    signal(SIGPIPE, SIG_IGN);
+    if (n_workers == 0) n_workers = 1;
+    pthread_t workers[n_workers];
+    for (unsigned int i = 0; i < n_workers; i++)
+        pthread_create(&workers[i], NULL, worker, NULL);
+
+    if (strcmp(path, "-") == 0) {
+        serve_connection(new_connection(stdin, STDOUT_FILENO));
+        pthread_mutex_lock(&queue_mtx);
+        queue_closed = true;
+        pthread_cond_broadcast(&queue_cv);
+        pthread_mutex_unlock(&queue_mtx);
+        for (unsigned int i = 0; i < n_workers; i++)
+            pthread_join(workers[i], NULL);
+        return 0;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof addr.sun_path) {
+        printf("Socket path too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof addr) < 0 || listen(fd, 64) < 0) {
+        perror(path);
+        return 1;
+    }
+    for (int cfd; (cfd = accept(fd, NULL, NULL)) >= 0; ) {
+        pthread_t t;
+        pthread_create(&t, NULL, connection_thread, new_connection(fdopen(cfd, "r"), cfd));
+        pthread_detach(t);
+    }
+    perror("accept");
+    close(fd);
+    return 1;
+}
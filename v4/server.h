@@ -0,0 +1,31 @@
+/*
+ *  graphISO: Tools to compute the Maximum Common Subgraph between two graphs
+ *  Copyright (c) 2019 Stefano Quer
+ *  
+ *  This program is free software : you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.If not, see < http: *www.gnu.org/licenses/>
+ */
+
+#ifndef TRIMBLE_IT_MULTI_SERVER_H
+#define TRIMBLE_IT_MULTI_SERVER_H
+
+#include "mcs.h"
+
+// Serves the requests described in server.c on the Unix socket at path, or on
+// stdin and stdout if path is "-", with n_workers solvers. Files named by load
+// are read in format; defaults holds the options of the requests that do not
+// set them. The workers share cache, unless it is NULL. Only returns on
+// errors, or at the end of stdin.
+int run_server(const char *path, unsigned int n_workers, char format, int flags, const mcs_options_t *defaults, mcs_cache_t *cache);
+
+#endif //TRIMBLE_IT_MULTI_SERVER_H
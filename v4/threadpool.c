@@ -18,23 +18,20 @@
 
 #include "threadpool.h"
 
-void *func(void *args);
+static void *func(void *args);
 
 
 
-
-pool_t *init_pool(uint pool_size, int timeout, struct timespec start, bool connected) {
+// The threads are started once and then wait for the work of any number of
+// searches, each one set up by reset_pool, until stop_pool.
+pool_t *init_pool(uint pool_size) {
 	pool_t *pool = malloc(sizeof *pool);
 	pool->pool_size = pool_size;
 	pool->args_n = 2 * pool->pool_size; // initial average of two domains per thread
 	pool->args = malloc(pool->args_n * sizeof *pool->args);
 	pool->threads = malloc(pool->pool_size * sizeof *pool->threads);
 	pool->n_th = 0;
-
-	pool->timeout = timeout;
-	pool->start = start;
-
-	pool->connected = connected;
+	pool->stop = false;
 
 	pthread_mutex_init(&pool->idle_mtx, NULL);
 	pthread_cond_init(&pool->idle_cv, NULL);
@@ -49,9 +46,9 @@ pool_t *init_pool(uint pool_size, int timeout, struct timespec start, bool conne
 	pthread_cond_init(&pool->finish_cv, NULL);
 	pool->canFinish = 0;
 	pthread_mutex_init(&pool->inc_mtx, NULL);
-	pool->global_inc = 0;
 	//pool->inc_size = malloc(pool_size*sizeof *pool->inc_size);
 	//pool->incumbents = malloc(pool_size*sizeof *pool->incumbents);
+	reset_pool(pool, NULL, POOL_LEVEL, 0, (struct timespec){0}, false, 0);
 
 
 	for (uint i = 0; i < pool->pool_size; i++) {
@@ -64,10 +61,26 @@ pool_t *init_pool(uint pool_size, int timeout, struct timespec start, bool conne
 	return pool;
 }
 
-void *func(void *args) {
+// Called by the owner of the pool while the threads are idle.
+void reset_pool(pool_t *pool, const problem_t *pb, uint level, double timeout, struct timespec start, bool connected, uint target) {
+	pool->pb = pb;
+	pool->level = level;
+	pool->n_th = 0;
+
+	pool->timeout = timeout;
+	pool->start = start;
+
+	pool->connected = connected;
+	pool->target = target;
+	atomic_init(&pool->target_reached, false); // @suppress("Type cannot be resolved")
+	pool->global_inc = 0;
+}
+
+static void *func(void *args) {
 	thread_args_t *a = (thread_args_t*)args;
 	uint my_idx = a->idx;
 	pool_t *pool = a->pool;
+	free(a);
 
 	uchar v, w, *bd, *left, *right, (*domains)[BDS];
 	uchar (*cur)[2] = pool->args[my_idx].current;
@@ -90,6 +103,7 @@ void *func(void *args) {
 
 
 		if (!pool->stop) {
+			const problem_t *pb = pool->pb;
 			if(my_idx < pool->n_th) {
 				domains = pool->args[my_idx].domains;
 				bd_pos = pool->args[my_idx].bd_pos;
@@ -104,10 +118,14 @@ void *func(void *args) {
 						pool->timeout = -1;
 						break;
 					}
+					if (pool->target && pool->inc_size[my_idx] >= pool->target)
+						atomic_store(&pool->target_reached, true); // @suppress("Type cannot be resolved")
+					if (atomic_load(&pool->target_reached)) // @suppress("Type cannot be resolved")
+						break;
 
 					bd = &domains[bd_pos - 1][L];
 
-					if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] <= pool->inc_size[my_idx] ||
+					if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] + (bd[RL] != bd[IRL]) <= pool->inc_size[my_idx] ||
 							(bd[LL] == 0 && bd[RL] == bd[IRL]))
 						bd_pos--;
 					else {
@@ -118,6 +136,8 @@ void *func(void *args) {
 							right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
 							right[bd[R] + bd[RL]] = w;
 							bd[W] = w;                      // store the W used for this iteration
+							if (twin_already_tried(pb, right, bd, w))
+								continue;
 							cur[bd[P]][L] = v;
 							cur[bd[P]][R] = w;
 							pthread_mutex_lock(&pool->inc_mtx);
@@ -128,8 +148,9 @@ void *func(void *args) {
 							} else pthread_mutex_unlock(&pool->inc_mtx);
 
 
-							generate_next_domains(domains, &bd_pos, bd[P] + 1, left, right, v, w, pool->inc_size[my_idx]);
-						}
+							generate_next_domains(pb, domains, &bd_pos, bd[P] + 1, left, right, v, w, pool->inc_size[my_idx]);
+						} else
+							remove_left_twins(pb, left, bd, v);
 					}
 				}
 			} else pool->inc_size[my_idx] = 0;
@@ -198,7 +219,7 @@ void compute(pool_t *pool, uchar *inc_size, uchar (*incumbent)[2]) {
 	pool->n_th = 0;
 }
 
-int stop_pool(pool_t *pool){
+void stop_pool(pool_t *pool){
 	pthread_mutex_lock(&pool->idle_mtx);
 	while (pool->currentlyIdle != pool->pool_size) {
 		pthread_cond_wait(&pool->idle_cv, &pool->idle_mtx);
@@ -220,20 +241,31 @@ int stop_pool(pool_t *pool){
 	for(int i = 0; i < pool->pool_size; i++){
 		pthread_join(pool->threads[i], NULL);
 	}
-	return pool->timeout;
+	pthread_mutex_destroy(&pool->idle_mtx);
+	pthread_cond_destroy(&pool->idle_cv);
+	pthread_mutex_destroy(&pool->ready_mtx);
+	pthread_cond_destroy(&pool->ready_cv);
+	pthread_mutex_destroy(&pool->working_mtx);
+	pthread_cond_destroy(&pool->working_cv);
+	pthread_mutex_destroy(&pool->finish_mtx);
+	pthread_cond_destroy(&pool->finish_cv);
+	pthread_mutex_destroy(&pool->inc_mtx);
+	free(pool->threads);
+	free(pool->args);
+	free(pool);
 }
 
 bool fill_pool_args(pool_t *pool, uchar (*domains)[BDS], uchar (*current)[2], const uchar *left, const uchar *right, uint *bd_pos, uint bd_n, uint inc_size){
 	pool->args[pool->n_th].bd_pos = 0;
 	for(uint i = 0; i < bd_n; i++, (*bd_pos)--)
 		add_bidomain(pool->args[pool->n_th].domains, &pool->args[pool->n_th].bd_pos, domains[*bd_pos-1][L], domains[*bd_pos-1][R], domains[*bd_pos-1][LL], domains[*bd_pos-1][RL], domains[*bd_pos-1][ADJ], domains[*bd_pos-1][P]);
-	for(int b = 0; b < POOL_LEVEL; b++)
+	for(int b = 0; b < pool->level; b++)
 		pool->args[pool->n_th].current[b][L] = current[b][L];
-	for(int b = 0; b < POOL_LEVEL; b++)
+	for(int b = 0; b < pool->level; b++)
 		pool->args[pool->n_th].current[b][R] = current[b][R];
-	for(int b = 0; b < n0; b++)
+	for(int b = 0; b < pool->pb->n0; b++)
 		pool->args[pool->n_th].left[b] = left[b];
-	for(int b = 0; b < n1; b++)
+	for(int b = 0; b < pool->pb->n1; b++)
 		pool->args[pool->n_th].right[b] = right[b];
 	pool->args[pool->n_th].start_inc_size = inc_size;
 	pool->n_th++;
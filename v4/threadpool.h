@@ -25,7 +25,7 @@
 
 
 typedef struct task_data_S{
-    uchar domains[MAX_GRAPH_SIZE*5][BDS];
+    uchar domains[MAX_DOMAINS][BDS];
     uint bd_pos;
     uchar left[MAX_GRAPH_SIZE], right[MAX_GRAPH_SIZE];
     uchar current[MAX_GRAPH_SIZE][2];
@@ -39,6 +39,8 @@ typedef struct thradpool{
     task_data_t *args;    //array of arguments from the main thread
     uint args_n;   //number of arguments (each of size args_size) in args array
 
+    const problem_t *pb;    // the pair being solved and the depth at which it is split, set by reset_pool
+    uint level;
     bool connected;
 
     pthread_mutex_t idle_mtx, ready_mtx, working_mtx, finish_mtx;
@@ -47,7 +49,7 @@ typedef struct thradpool{
 
     uint n_th;      // the current index in the args_indices array
 
-    int timeout;
+    double timeout;
     struct timespec start;
 
     pthread_mutex_t inc_mtx;
@@ -58,6 +60,8 @@ typedef struct thradpool{
 
     bool stop;
 
+    uint target;                // stop as soon as an incumbent reaches this size, 0 to search for the optimum
+    atomic_bool target_reached; // @suppress("Type cannot be resolved")
 
 }pool_t;
 
@@ -66,13 +70,15 @@ typedef struct thread_args_s{
     uint idx;
 } thread_args_t;
 
-pool_t *init_pool(uint pool_size, int timeout, struct timespec start, bool connected);
+pool_t *init_pool(uint pool_size);
+
+void reset_pool(pool_t *pool, const problem_t *pb, uint level, double timeout, struct timespec start, bool connected, uint target);
 
 bool fill_pool_args(pool_t *pool, uchar (*domains)[BDS], uchar (*current)[2], const uchar *left, const uchar *right, uint *bd_pos, uint bd_n, uint inc_size);
 
 void compute(pool_t *pool, uchar *inc_size, uchar (*incumbent)[2]);
 
-int stop_pool(pool_t *pool);
+void stop_pool(pool_t *pool);
 
 
 
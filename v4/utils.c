@@ -85,6 +85,26 @@ uchar select_next_v(uchar *left, uchar *bd){
     return min;
 }
 
+// Once v has been left unmatched, its twins in the same domain can be left
+// unmatched too: any mapping using one of them is mirrored by a mapping using v.
+void remove_left_twins(const problem_t *pb, uchar *left, uchar *bd, uchar v) {
+    for (int i = bd[LL] - 1; i >= 0; i--)
+        if (pb->twin0[left[bd[L] + i]] == pb->twin0[v]) {
+            uchar_swap(&left[bd[L] + i], &left[bd[L] + bd[LL] - 1]);
+            bd[LL]--;
+        }
+}
+
+// True if a twin of w with a smaller index is still in the right domain:
+// w's are tried in increasing order, so that twin already covered this branch.
+bool twin_already_tried(const problem_t *pb, uchar *right, uchar *bd, uchar w) {
+    if (pb->twin1[w] == w) return false;
+    for (uchar i = 0; i < bd[RL]; i++)
+        if (right[bd[R] + i] < w && pb->twin1[right[bd[R] + i]] == pb->twin1[w])
+            return true;
+    return false;
+}
+
 uchar select_next_w(uchar *right, uchar *bd) {
     uchar min = UCHAR_MAX, idx = UCHAR_MAX;
     for (uchar i = 0; i < bd[RL]+1; i++)
@@ -147,21 +167,77 @@ uchar partition(uchar *arr, uchar start, uchar len,
     return i;
 }
 
-void generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right, uchar v, uchar w, uint inc_pos) {
+// One bidomain at level 0 for each vertex label found in both graphs,
+// vertices with loops having labels of their own.
+void initial_domains(const problem_t *pb, uchar domains[][BDS], uint *bd_pos, uchar *left, uchar *right) {
+    for (uchar i = 0; i < pb->n0; i++)
+        left[i] = i;
+    for (uchar i = 0; i < pb->n1; i++)
+        right[i] = i;
+    INSERTION_SORT(uchar, left, pb->n0, pb->label0[left[j - 1]] > pb->label0[left[j]])
+    INSERTION_SORT(uchar, right, pb->n1, pb->label1[right[j - 1]] > pb->label1[right[j]])
+    for (uchar l = 0, r = 0; l < pb->n0 && r < pb->n1;) {
+        uint label = pb->label0[left[l]];
+        if (label < pb->label1[right[r]])
+            l++;
+        else if (label > pb->label1[right[r]])
+            r++;
+        else {
+            uchar start_l = l, start_r = r;
+            while (l < pb->n0 && pb->label0[left[l]] == label) l++;
+            while (r < pb->n1 && pb->label1[right[r]] == label) r++;
+            add_bidomain(domains, bd_pos, start_l, start_r, l - start_l, r - start_r, 0, 0);
+        }
+    }
+}
+
+// Splits the l_len vertices at left[l] and the r_len at right[r], all
+// adjacent to v and w, by the label of the edge and, in directed graphs, its
+// direction: both sides are sorted by adjacency value and every value found
+// on both sides makes a bidomain. Returns the sum of their bounds.
+static uint add_domains_by_edge_label(const problem_t *pb, uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right,
+                                      uchar l, uchar r, uchar l_len, uchar r_len, uchar v, uchar w) {
+    uchar *vv0 = left + l, *vv1 = right + r;
+    const uchar *adjrow0 = pb->adjmat0[v], *adjrow1 = pb->adjmat1[w];
+    INSERTION_SORT(uchar, vv0, l_len, adjrow0[vv0[j - 1]] > adjrow0[vv0[j]])
+    INSERTION_SORT(uchar, vv1, r_len, adjrow1[vv1[j - 1]] > adjrow1[vv1[j]])
+    uint bound = 0;
+    uchar i = 0, j = 0;
+    while (i < l_len && j < r_len) {
+        uchar label = adjrow0[vv0[i]];
+        if (label < adjrow1[vv1[j]])
+            i++;
+        else if (label > adjrow1[vv1[j]])
+            j++;
+        else {
+            uchar start_i = i, start_j = j;
+            while (i < l_len && adjrow0[vv0[i]] == label) i++;
+            while (j < r_len && adjrow1[vv1[j]] == label) j++;
+            add_bidomain(domains, bd_pos, l + start_i, r + start_j, i - start_i, j - start_j, true, (uchar) (cur_pos));
+            uint len = MIN(i - start_i, j - start_j);
+            bound += len;
+        }
+    }
+    return bound;
+}
+
+void generate_next_domains(const problem_t *pb, uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right, uchar v, uchar w, uint inc_pos) {
     int i;
     uint bd_backup = *bd_pos;
     uint bound = 0;
     uchar *bd;
     for (i = *bd_pos - 1, bd = &domains[i][L]; i >= 0 && bd[P] == cur_pos - 1; i--, bd = &domains[i][L]) {
 
-        uchar l_len = partition(left, bd[L], bd[LL], adjmat0[v]);
-        uchar r_len = partition(right, bd[R], bd[RL], adjmat1[w]);
+        uchar l_len = partition(left, bd[L], bd[LL], pb->adjmat0[v]);
+        uchar r_len = partition(right, bd[R], bd[RL], pb->adjmat1[w]);
 
         if (bd[LL] - l_len && bd[RL] - r_len) {
             add_bidomain(domains, bd_pos, bd[L] + l_len, bd[R] + r_len, bd[LL] - l_len, bd[RL] - r_len, bd[ADJ], (uchar) (cur_pos));
             bound += MIN(bd[LL] - l_len, bd[RL] - r_len);
         }
-        if (l_len && r_len) {
+        if (l_len && r_len && pb->edge_labelled) {
+            bound += add_domains_by_edge_label(pb, domains, bd_pos, cur_pos, left, right, bd[L], bd[R], l_len, r_len, v, w);
+        } else if (l_len && r_len) {
             add_bidomain(domains, bd_pos, bd[L], bd[R], l_len, r_len, true, (uchar) (cur_pos));
             bound += MIN(l_len, r_len);
         }
@@ -173,32 +249,39 @@ void generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uch
 bool check_sol(graph_t *g0, graph_t *g1, uchar sol[][2], uint sol_len) {
     bool *used_left = (bool*) calloc(g0->n, sizeof *used_left);
     bool *used_right = (bool*) calloc(g1->n, sizeof *used_right);
-    for (int i = 0; i < sol_len; i++) {
+    bool ok = true;
+    for (int i = 0; i < sol_len && ok; i++) {
         if (used_left[sol[i][L]]) {
             printf("node %d of g0 used twice\n", used_left[sol[i][L]]);
-            return false;
+            ok = false;
+            break;
         }
         if (used_right[sol[i][R]]) {
             printf("node %d of g1 used twice\n", used_right[sol[i][L]]);
-            return false;
+            ok = false;
+            break;
         }
         used_left[sol[i][L]] = true;
         used_right[sol[i][R]] = true;
         if (g0->label[sol[i][L]] != g1->label[sol[i][R]]) {
             printf("g0:%d and g1:%d have different labels\n", sol[i][L],
                    sol[i][R]);
-            return false;
+            ok = false;
+            break;
         }
         for (int j = i + 1; j < sol_len; j++) {
             if (g0->adjmat[sol[i][L]][sol[j][L]]
                 != g1->adjmat[sol[i][R]][sol[j][R]]) {
                 printf("g0(%d-%d) is different than g1(%d-%d)\n", sol[i][L],
                        sol[j][L], sol[i][R], sol[j][R]);
-                return false;
+                ok = false;
+                break;
             }
         }
     }
-    return true;
+    free(used_left);
+    free(used_right);
+    return ok;
 }
 
 double compute_elapsed_millisec(struct timespec start){
@@ -50,15 +50,24 @@
 
 #define MIN(a, b) (a < b)? a : b
 
-#define POOL_LEVEL 5
+#define POOL_LEVEL 5         // default depth at which subtrees are handed to the pool
 #define MAX_GRAPH_SIZE 64
+#define MAX_DOMAINS (MAX_GRAPH_SIZE * (MAX_GRAPH_SIZE + 1) / 2)    // a level of the stack has at most a domain per vertex left
 #define DEFAULT_THREADS 8
 
-uchar adjmat0[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE], adjmat1[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE], n0, n1;
-
 typedef unsigned int uint;
 typedef unsigned char uchar;
 
+// The pair of graphs being solved, renumbered by degree. Every solver has its
+// own, so that several searches can run in the same process.
+typedef struct problem_s {
+    uchar n0, n1;
+    uchar adjmat0[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE], adjmat1[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
+    uchar twin0[MAX_GRAPH_SIZE], twin1[MAX_GRAPH_SIZE];
+    uint label0[MAX_GRAPH_SIZE], label1[MAX_GRAPH_SIZE];
+    bool edge_labelled;     // some edge has a label other than 0 or is an arc, so domains are split by edge value too
+} problem_t;
+
 void *safe_realloc(void* old, uint new_size);
 
 void uchar_swap(uchar *a, uchar *b);
@@ -69,6 +78,10 @@ uchar select_next_v(uchar *left, uchar *bd);
 
 void select_bidomain(uchar domains[][BDS], uint bd_pos, uchar *left, int current_matching_size, bool connected);
 
+void remove_left_twins(const problem_t *pb, uchar *left, uchar *bd, uchar v);
+
+bool twin_already_tried(const problem_t *pb, uchar *right, uchar *bd, uchar w);
+
 void update_incumbent(uchar cur[][2], uchar inc[][2], uchar cur_pos, uchar *inc_pos, uint th_idx);
 
 // BIDOMAINS FUNCTIONS /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -78,7 +91,10 @@ uint calc_bound(uchar domains[][BDS], uint bd_pos, uint cur_pos, uint *bd_n);
 
 uchar partition(uchar *arr, uchar start, uchar len, const uchar *adjrow);
 
-void generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right, uchar v, uchar w, uint inc_pos);
+// Fills left and right and adds the domains of level 0, one per vertex label
+void initial_domains(const problem_t *pb, uchar domains[][BDS], uint *bd_pos, uchar *left, uchar *right);
+
+void generate_next_domains(const problem_t *pb, uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *left, uchar *right, uchar v, uchar w, uint inc_pos);
 
 bool check_sol(graph_t *g0, graph_t *g1, uchar sol[][2], uint sol_len);
 
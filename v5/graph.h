@@ -42,30 +42,47 @@ typedef unsigned int uint;
 } while(0);
 
 
+#define EDGE_LABEL_BITS 7      // so that 1 + an edge label fits in a byte of adjmat
+#define ARC_LABEL_BITS 3       // and in half a byte for the arcs of directed graphs
+
 typedef struct graph_s {
 	uchar n; // let's start with small graphs, we have problem with graphs size 30 so uchar is big enough
 	uchar **adjmat;
 	uint *label;
 	uint *degree;
+	uint *twin;
 } graph_t;
 
+// Sets g->n and allocates zeroed labels and adjacency matrix
+void alloc_graph(graph_t *g, int n);
+
 unsigned int* calculate_degrees(graph_t *g);
 
+unsigned int* calculate_twins(graph_t *g);
+
+// A copy of g renumbered so that vertex i is vertex vv[i] of g, whose
+// degrees are moved rather than counted
 graph_t *induced_subgraph(graph_t *g, int *vv);
 
 int graph_edge_count(graph_t *g);
 
+// format is 'B' (binary) or 'L' (LAD); the labels of binary files are
+// only read if labelled
 // Precondition: *g is already zeroed out
-void readGraph(char* filename, graph_t* g, char format);
+void readGraph(char* filename, graph_t* g, char format, bool directed, bool labelled);
 
 // Precondition: *g is already zeroed out
-void readBinaryGraph(char* filename, graph_t* g);
+void readBinaryGraph(char* filename, graph_t* g, bool directed, bool labelled);
 
 // Precondition: *g is already zeroed out
-void readLadGraph(char* filename, graph_t* g);
+void readLadGraph(char* filename, graph_t* g, bool directed);
 
 void free_graph(graph_t *g);
 
+// Renumbers g in place so that vertex i is vertex vv[i] of g
+void permute_graph(graph_t *g, int *vv);
+
+// Sorts g in place by degree and returns it
 graph_t *sort_vertices_by_degree(graph_t *g, bool ascending);
 
 
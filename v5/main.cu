@@ -46,6 +46,8 @@
 #define N_BLOCKS 64
 #define BLOCK_SIZE 512
 #define MAX_GRAPH_SIZE 64
+#define MAX_DOMAINS (MAX_GRAPH_SIZE * (MAX_GRAPH_SIZE + 1) / 2)	// a level of the stack has at most a domain per vertex left
+#define UNLABELLED_DOMAINS (MAX_GRAPH_SIZE * 5)	// without edge labels a domain splits in at most two, so the kernel keeps its smaller stack
 #define checkCudaErrors(value) CheckCudaErrorAux(__FILE__,__LINE__, #value, value)
 
 typedef unsigned char uchar;
@@ -55,20 +57,34 @@ __constant__ uchar d_adjmat0[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
 __constant__ uchar d_adjmat1[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
 __constant__ uchar d_n0;
 __constant__ uchar d_n1;
+__constant__ uchar d_twin0[MAX_GRAPH_SIZE];
+__constant__ uchar d_twin1[MAX_GRAPH_SIZE];
+__constant__ bool d_edge_labelled;
 
 uchar adjmat0[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
 uchar adjmat1[MAX_GRAPH_SIZE][MAX_GRAPH_SIZE];
 uchar n0;
 uchar n1;
+uchar twin0[MAX_GRAPH_SIZE];
+uchar twin1[MAX_GRAPH_SIZE];
+uint label0[MAX_GRAPH_SIZE];
+uint label1[MAX_GRAPH_SIZE];
+bool edge_labelled = false;	// some edge has a label other than 0 or is an arc, so domains are split by edge value too
 
 uint __gpu_level = 5;
 struct timespec start;
+uint target = 0;	// stop as soon as the incumbent reaches this size, 0 to search for the optimum
 
 static struct argp_option options[] = {
 		{ "verbose", 'v', 0, 0, "Verbose output" },
 		{ "lad", 'l', 0, 0, "Read LAD format"},
+		{ "labelled", 'L', 0, 0, "Match the vertex and edge labels of binary files"},
+		{ "directed", 'i', 0, 0, "Read the graphs as directed, and match arcs with arcs of the same direction"},
 		{ "timeout", 't', "timeout", 0, "Set timeout of TIMEOUT milliseconds"},
 		{ "connected", 'c', 0, 0, "Solve max common CONNECTED subgraph problem" },
+		{ "at-least", 'a', "K", 0, "Stop as soon as a common subgraph of K vertices is found, or proven not to exist" },
+		{ "ratio", 'r', "R", 0, "Same as --at-least with K = R * min(n0,n1), rounded up" },
+		{ "split-level", 's', "LEVEL", 0, "Hand the subtrees at depth LEVEL to the GPU" },
 		{ 0 }
 };
 
@@ -77,8 +93,12 @@ static char args_doc[] = "FILENAME1 FILENAME2";
 static struct {
 	bool verbose;
 	bool lad;
+	bool labelled;
+	bool directed;
 	bool connected;
 	int timeout;
+	int at_least;
+	double ratio;
 	char *filename1;
 	char *filename2;
 	int arg_num;
@@ -86,8 +106,12 @@ static struct {
 void set_default_arguments() {
 	arguments.verbose = false;
 	arguments.lad = false;
+	arguments.labelled = false;
+	arguments.directed = false;
 	arguments.timeout = 0;
 	arguments.connected = false;
+	arguments.at_least = 0;
+	arguments.ratio = 0;
 	arguments.filename1 = NULL;
 	arguments.filename2 = NULL;
 	arguments.arg_num = 0;
@@ -103,9 +127,25 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
 	case 'l':
 		arguments.lad = true;
 		break;
+	case 'L':
+		arguments.labelled = true;
+		break;
+	case 'i':
+		arguments.directed = true;
+		break;
 	case 'c':
 		arguments.connected = true;
 		break;
+	case 'a':
+		arguments.at_least = strtol(arg, NULL, 10);
+		break;
+	case 'r':
+		arguments.ratio = strtod(arg, NULL);
+		break;
+	case 's':
+		__gpu_level = strtol(arg, NULL, 10);
+		if (__gpu_level >= MAX_GRAPH_SIZE) __gpu_level = MAX_GRAPH_SIZE - 1;
+		break;
 	case ARGP_KEY_ARG:
 		if (arguments.arg_num == 0) {
 			arguments.filename1 = arg;
@@ -199,6 +239,28 @@ void remove_from_domain(uchar *arr, const uchar *start_idx, uchar *len,
 	(*len)--;
 }
 
+// Once v has been left unmatched, its twins in the same domain can be left
+// unmatched too: any mapping using one of them is mirrored by a mapping using v.
+__host__ __device__
+void remove_left_twins(uchar *left, uchar *bd, uchar v, const uchar *twin) {
+	for (int i = bd[LL] - 1; i >= 0; i--)
+		if (twin[left[bd[L] + i]] == twin[v]) {
+			uchar_swap(&left[bd[L] + i], &left[bd[L] + bd[LL] - 1]);
+			bd[LL]--;
+		}
+}
+
+// True if a twin of w with a smaller index is still in the right domain:
+// w's are tried in increasing order, so that twin already covered this branch.
+__host__ __device__
+bool twin_already_tried(const uchar *right, const uchar *bd, uchar w, const uchar *twin) {
+	if (twin[w] == w) return false;
+	for (uchar i = 0; i < bd[RL]; i++)
+		if (right[bd[R] + i] < w && twin[right[bd[R] + i]] == twin[w])
+			return true;
+	return false;
+}
+
 __host__ __device__
 void update_incumbent(uchar cur[][2], uchar inc[][2], uchar cur_pos,
 		uchar *inc_pos) {
@@ -250,6 +312,36 @@ __host__  __device__ uchar partition(uchar *arr, uchar start, uchar len,
 	return i;
 }
 
+// Splits the l_len vertices at vv0 (left[l]) and the r_len at vv1
+// (right[r]), all adjacent to v and w, by the label of the edge and, in
+// directed graphs, its direction: both sides are sorted by adjacency value
+// and every value found on both sides makes a bidomain. Returns the sum of
+// their bounds.
+__host__  __device__
+uint add_domains_by_edge_label(uchar domains[][BDS], uint *bd_pos, uint cur_pos, uchar *vv0, uchar *vv1, uchar l, uchar r,
+		uchar l_len, uchar r_len, const uchar *adjrow0, const uchar *adjrow1) {
+	INSERTION_SORT(uchar, vv0, l_len, adjrow0[vv0[j - 1]] > adjrow0[vv0[j]])
+	INSERTION_SORT(uchar, vv1, r_len, adjrow1[vv1[j - 1]] > adjrow1[vv1[j]])
+	uint bound = 0;
+	uchar i = 0, j = 0;
+	while (i < l_len && j < r_len) {
+		uchar label = adjrow0[vv0[i]];
+		if (label < adjrow1[vv1[j]])
+			i++;
+		else if (label > adjrow1[vv1[j]])
+			j++;
+		else {
+			uchar start_i = i, start_j = j;
+			while (i < l_len && adjrow0[vv0[i]] == label) i++;
+			while (j < r_len && adjrow1[vv1[j]] == label) j++;
+			add_bidomain(domains, bd_pos, l + start_i, r + start_j, i - start_i, j - start_j, true, (uchar) (cur_pos));
+			uint len = MIN(i - start_i, j - start_j);
+			bound += len;
+		}
+	}
+	return bound;
+}
+
 __host__  __device__
 uchar find_min_value(uchar *arr, uchar start_idx, uchar len){
 	uchar min_v = UCHAR_MAX;
@@ -314,7 +406,9 @@ void d_generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, u
 			add_bidomain(domains, bd_pos, bd[L] + l_len, bd[R] + r_len, bd[LL] - l_len, bd[RL] - r_len, bd[ADJ], (uchar) (cur_pos));
 			bound += MIN(bd[LL] - l_len, bd[RL] - r_len);
 		}
-		if (l_len && r_len) {
+		if (l_len && r_len && d_edge_labelled) {
+			bound += add_domains_by_edge_label(domains, bd_pos, cur_pos, left + bd[L], right + bd[R], bd[L], bd[R], l_len, r_len, d_adjmat0[v], d_adjmat1[w]);
+		} else if (l_len && r_len) {
 			add_bidomain(domains, bd_pos, bd[L], bd[R], l_len, r_len, true, (uchar) (cur_pos));
 			bound += MIN(l_len, r_len);
 		}
@@ -323,11 +417,13 @@ void d_generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos, u
 		*bd_pos = bd_backup;
 }
 
-__global__
-void d_mcs(uchar *args, uint n_threads, uchar a_size, uint *args_i, uint actual_inc, uchar *device_solutions, uint max_sol_size, uint last_arg, bool verbose, bool connected) {
+// STACK is the capacity of the domain stack in the local memory of each
+// thread: UNLABELLED_DOMAINS or, with edge labels, MAX_DOMAINS
+template <uint STACK> __global__
+void d_mcs(uchar *args, uint n_threads, uchar a_size, uint *args_i, uint actual_inc, uchar *device_solutions, uint max_sol_size, uint last_arg, bool verbose, bool connected, uint target) {
 	uint my_idx = (blockIdx.x * blockDim.x) + threadIdx.x;
 	uchar cur[MAX_GRAPH_SIZE][2], incumbent[MAX_GRAPH_SIZE][2],
-	domains[MAX_GRAPH_SIZE * 5][BDS], left[MAX_GRAPH_SIZE],
+	domains[STACK][BDS], left[MAX_GRAPH_SIZE],
 	right[MAX_GRAPH_SIZE], v, w;
 	uint bd_pos = 0, bd_n = 0;
 	uchar inc_pos = 0;
@@ -347,6 +443,8 @@ void d_mcs(uchar *args, uint n_threads, uchar a_size, uint *args_i, uint actual_
 				right[r] = args[i++];
 		}
 		while (bd_pos > 0) {
+			if (target && sh_inc >= target)
+				break;
 			uchar *bd = &domains[bd_pos - 1][L];
 			
 			if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] + (bd[RL] != bd[IRL]) <= sh_inc || (bd[LL] == 0 && bd[RL] == bd[IRL])) {
@@ -364,11 +462,14 @@ void d_mcs(uchar *args, uint n_threads, uchar a_size, uint *args_i, uint actual_
 				} else v = left[bd[L] + bd[LL]];
 				if ((bd[W] = index_of_next_smallest(right, bd[R], bd[RL] + (uchar) 1, bd[W])) == UCHAR_MAX) {
 					bd[RL]++;
+					remove_left_twins(left, bd, v, d_twin0);
 				} else {
 					w = right[bd[R] + bd[W]];
 					right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
 					right[bd[R] + bd[RL]] = w;
 					bd[W] = w;
+					if (twin_already_tried(right, bd, w, d_twin1))
+						continue;
 					cur[bd[P]][L] = v;
 					cur[bd[P]][R] = w;
 					update_incumbent(cur, incumbent, bd[P] + 1, &inc_pos);
@@ -417,6 +518,33 @@ void move_graphs_to_gpu(graph_t *g0, graph_t *g1) {
 	checkCudaErrors(cudaMemcpyToSymbol(d_n1, &g1->n, sizeof(uchar)));
 	checkCudaErrors(cudaMemcpyToSymbol(d_adjmat0, adjmat0, MAX_GRAPH_SIZE*MAX_GRAPH_SIZE));
 	checkCudaErrors(cudaMemcpyToSymbol(d_adjmat1, adjmat1, MAX_GRAPH_SIZE*MAX_GRAPH_SIZE));
+	checkCudaErrors(cudaMemcpyToSymbol(d_twin0, twin0, MAX_GRAPH_SIZE));
+	checkCudaErrors(cudaMemcpyToSymbol(d_twin1, twin1, MAX_GRAPH_SIZE));
+	checkCudaErrors(cudaMemcpyToSymbol(d_edge_labelled, &edge_labelled, sizeof(bool)));
+}
+
+// One bidomain at level 0 for each vertex label found in both graphs,
+// vertices with loops having labels of their own.
+void initial_domains(uchar domains[][BDS], uint *bd_pos, uchar *left, uchar *right) {
+	for (uchar i = 0; i < n0; i++)
+		left[i] = i;
+	for (uchar i = 0; i < n1; i++)
+		right[i] = i;
+	INSERTION_SORT(uchar, left, n0, label0[left[j - 1]] > label0[left[j]])
+	INSERTION_SORT(uchar, right, n1, label1[right[j - 1]] > label1[right[j]])
+	for (uchar l = 0, r = 0; l < n0 && r < n1;) {
+		uint label = label0[left[l]];
+		if (label < label1[right[r]])
+			l++;
+		else if (label > label1[right[r]])
+			r++;
+		else {
+			uchar start_l = l, start_r = r;
+			while (l < n0 && label0[left[l]] == label) l++;
+			while (r < n1 && label1[right[r]] == label) r++;
+			add_bidomain(domains, bd_pos, start_l, start_r, l - start_l, r - start_r, 0, 0);
+		}
+	}
 }
 
 
@@ -436,7 +564,9 @@ void h_generate_next_domains(uchar domains[][BDS], uint *bd_pos, uint cur_pos,
 			add_bidomain(domains, bd_pos, bd[L] + l_len, bd[R] + r_len, bd[LL] - l_len, bd[RL] - r_len, bd[ADJ], (uchar) (cur_pos));
 			bound += MIN(bd[LL] - l_len, bd[RL] - r_len);
 		}
-		if (l_len && r_len) {
+		if (l_len && r_len && edge_labelled) {
+			bound += add_domains_by_edge_label(domains, bd_pos, cur_pos, left + bd[L], right + bd[R], bd[L], bd[R], l_len, r_len, adjmat0[v], adjmat1[w]);
+		} else if (l_len && r_len) {
 			add_bidomain(domains, bd_pos, bd[L], bd[R], l_len, r_len, true, (uchar) (cur_pos));
 			bound += MIN(l_len, r_len);
 		}
@@ -506,7 +636,10 @@ void launch_kernel(uchar *args, uint n_threads, uchar a_size, uint sol_size, uin
 
 	if(arguments.verbose) printf("Launching kernel...\n");
 
-	d_mcs<<<N_BLOCKS, BLOCK_SIZE>>>(device_args, n_threads, a_size, device_args_i, *inc_pos, device_solutions, max_sol_size, last_arg, arguments.verbose, arguments.connected);
+	if (edge_labelled)
+		d_mcs<MAX_DOMAINS><<<N_BLOCKS, BLOCK_SIZE>>>(device_args, n_threads, a_size, device_args_i, *inc_pos, device_solutions, max_sol_size, last_arg, arguments.verbose, arguments.connected, target);
+	else
+		d_mcs<UNLABELLED_DOMAINS><<<N_BLOCKS, BLOCK_SIZE>>>(device_args, n_threads, a_size, device_args_i, *inc_pos, device_solutions, max_sol_size, last_arg, arguments.verbose, arguments.connected, target);
 	checkCudaErrors(cudaEventRecord(stop));
 
 	while(cudaEventQuery(stop) == cudaErrorNotReady){
@@ -543,13 +676,9 @@ void *safe_realloc(void* old, uint new_size){
 
 void mcs(uchar incumbent[][2], uchar *inc_pos) {
 	uint bd_pos = 0, bd_n = 0;
-	uchar cur[MAX_GRAPH_SIZE][2], domains[MAX_GRAPH_SIZE * 5][BDS], left[n0],
+	uchar cur[MAX_GRAPH_SIZE][2], domains[MAX_DOMAINS][BDS], left[n0],
 	right[n1], v, w;
-	for (uchar i = 0; i < n0; i++)
-		left[i] = i;
-	for (uchar i = 0; i < n1; i++)
-		right[i] = i;
-	add_bidomain(domains, &bd_pos, 0, 0, n0, n1, 0, 0);
+	initial_domains(domains, &bd_pos, left, right);
 	//supposing an initial average of 2 domains for thread, it will be reallocated if necessary
 	uint args_num = N_BLOCKS * BLOCK_SIZE * 2;
 	uint a_size = (BDS - 2 + 2 * __gpu_level + n0 + n1);
@@ -565,6 +694,8 @@ void mcs(uchar incumbent[][2], uchar *inc_pos) {
 			arguments.timeout = -1;
 			return;
 		}
+		if (target && *inc_pos >= target)
+			return;
 		uchar *bd = &domains[bd_pos - 1][L];
 
 		if (calc_bound(domains, bd_pos, bd[P], &bd_n) + bd[P] + (bd[RL] != bd[IRL]) <= *inc_pos || (bd[LL] == 0 && bd[RL] == bd[IRL])) {
@@ -617,12 +748,15 @@ void mcs(uchar incumbent[][2], uchar *inc_pos) {
 
 		if ((bd[W] = index_of_next_smallest(right, bd[R], bd[RL] + (uchar) 1, bd[W])) == UCHAR_MAX) {
 			bd[RL]++;
+			remove_left_twins(left, bd, v, twin0);
 		} else {
 			w = right[bd[R] + bd[W]];
 			right[bd[R] + bd[W]] = right[bd[R] + bd[RL]];
 			right[bd[R] + bd[RL]] = w;
 
 			bd[W] = w;
+			if (twin_already_tried(right, bd, w, twin1))
+				continue;
 
 			cur[bd[P]][L] = v;
 			cur[bd[P]][R] = w;
@@ -637,6 +771,23 @@ void mcs(uchar incumbent[][2], uchar *inc_pos) {
 		launch_kernel(args, n_threads, a_size, sol_size, args_i, incumbent, inc_pos, args_size, n_args*a_size);
 }
 
+// Threshold version of mcs: the incumbent starts at threshold-1, so the bound
+// prunes every branch that cannot reach it, on the host and in the kernel.
+// The root bound is min(n0,n1), so a threshold above it fails without searching.
+void mcs_at_least(uchar incumbent[][2], uchar *inc_pos, uint threshold) {
+	uint min = MIN(n0, n1);
+	if (threshold > min) {
+		printf("root bound %d below threshold\n", min);
+		return;
+	}
+	*inc_pos = threshold - 1;
+	target = threshold;
+	mcs(incumbent, inc_pos);
+	if (*inc_pos < threshold)
+		*inc_pos = 0;	// threshold-1 was only a bound
+	target = 0;
+}
+
 int main(int argc, char** argv) {
 	set_default_arguments();
 	argp_parse(&argp, argc, argv, 0, 0, 0);
@@ -644,9 +795,11 @@ int main(int argc, char** argv) {
 	double time_elapsed;
 	char format = arguments.lad ? 'L' : 'B';
 	graph_t *g0 = (graph_t*) calloc(1, sizeof *g0);
-	readGraph(arguments.filename1, g0, format);
+	readGraph(arguments.filename1, g0, format, arguments.directed, arguments.labelled);
 	graph_t *g1 = (graph_t*) calloc(1, sizeof *g1);
-	readGraph(arguments.filename2, g1, format);
+	readGraph(arguments.filename2, g1, format, arguments.directed, arguments.labelled);
+	if (format != 'L')
+		printf("%d vertices\n%d vertices\n", g0->n, g1->n);
 	g0 = sort_vertices_by_degree(g0,
 			(graph_edge_count(g1) > g1->n * (g1->n - 1) / 2));
 	g1 = sort_vertices_by_degree(g1,
@@ -662,16 +815,41 @@ int main(int argc, char** argv) {
 	for (int i = 0; i < n1; i++)
 		for (int j = 0; j < n1; j++)
 			adjmat1[i][j] = g1->adjmat[i][j];
+
+	for (int i = 0; i < n0; i++) {
+		twin0[i] = g0->twin[i];
+		label0[i] = g0->label[i];
+	}
+	for (int i = 0; i < n1; i++) {
+		twin1[i] = g1->twin[i];
+		label1[i] = g1->label[i];
+	}
+	for (int i = 0; i < n0; i++)
+		for (int j = 0; j < n0; j++)
+			edge_labelled |= adjmat0[i][j] > 1;
+	for (int i = 0; i < n1; i++)
+		for (int j = 0; j < n1; j++)
+			edge_labelled |= adjmat1[i][j] > 1;
 	checkCudaErrors(cudaDeviceReset());
 	move_graphs_to_gpu(g0, g1);
 	uchar solution[min_size][2];
 	uchar sol_len = 0;
+	uint threshold = arguments.at_least;
+	if (arguments.ratio > 0) {
+		double k = arguments.ratio * min_size;
+		threshold = (uint)k + ((uint)k < k);
+	}
 	clock_gettime(CLOCK_MONOTONIC, &start);
-	mcs(solution, &sol_len);
+	if (threshold)
+		mcs_at_least(solution, &sol_len, threshold);
+	else
+		mcs(solution, &sol_len);
 	clock_gettime(CLOCK_MONOTONIC, &finish);
 
 	if(arguments.timeout == -1){
 		printf("TIMEOUT\n");
+	} else if (threshold) {
+		printf("Threshold %d %s\n", threshold, sol_len >= threshold ? "reached" : "not reachable");
 	}
 
 	printf("------------------------------------------------------------\n");